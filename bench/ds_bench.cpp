@@ -0,0 +1,982 @@
+/**
+ * @file ds_bench.cpp
+ * @brief Desktop-Saver benchmarks.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.hpp"
+#include "json_arena.hpp"
+#include "layout_index.hpp"
+#include "layout_json.hpp"
+#include "util.hpp"
+
+#if !defined(_WIN32)
+#include <fstream>
+#include <ftw.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "linux_desktop_backend.hpp"
+#include "commit_group.hpp"
+#include "move_engine.hpp"
+#include "save_data.hpp"
+#include "switch_journal.hpp"
+#endif
+
+/** For convenience. */
+using json = nlohmann::json;
+
+namespace
+{
+	/** Room in front of every allocation for its size, keeping the alignment of operator new. */
+	constexpr size_t alloc_header = alignof(std::max_align_t);
+
+	/** Number of allocations. */
+	std::atomic<size_t> g_alloc_count(0);
+
+	/** Bytes allocated. */
+	std::atomic<size_t> g_alloc_bytes(0);
+
+	/** Bytes currently allocated. */
+	std::atomic<size_t> g_live_bytes(0);
+
+	/** Most bytes allocated at once. */
+	std::atomic<size_t> g_peak_bytes(0);
+
+	/**
+	 * Allocation counts over a stretch of code.
+	 */
+	struct AllocStats
+	{
+		/** Number of allocations. */
+		size_t count = 0;
+
+		/** Bytes allocated. */
+		size_t bytes = 0;
+
+		/** Most bytes allocated at once, above what was allocated at the start. */
+		size_t peak = 0;
+	};
+
+	/**
+	 * Count the allocations of a function.
+	 * @param Function to run.
+	 * @return Allocation counts.
+	 */
+	template<typename F>
+	AllocStats count_allocations(F&& f)
+	{
+		const size_t count = g_alloc_count;
+		const size_t bytes = g_alloc_bytes;
+		const size_t live = g_live_bytes;
+		g_peak_bytes = live;
+
+		f();
+
+		AllocStats stats = {};
+		stats.count = g_alloc_count - count;
+		stats.bytes = g_alloc_bytes - bytes;
+		stats.peak = g_peak_bytes - live;
+		return stats;
+	}
+	/**
+	 * Time a function.
+	 * @param Function to run.
+	 * @return Time taken in milliseconds.
+	 */
+	template<typename F>
+	double time_ms(F&& f)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/**
+	 * Make a desktop worth of icons.
+	 * @param Number of icons.
+	 * @param Every how many icons a name repeats, or 0 for unique names.
+	 * @return Icons.
+	 */
+	std::vector<ds::DesktopIcon> make_icons(size_t count, size_t duplicate_every)
+	{
+		std::vector<ds::DesktopIcon> icons(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const size_t id = duplicate_every != 0 && i % duplicate_every == 1 ? i - 1 : i;
+			icons[i].name = "Icon " + std::to_string(id) + ".lnk";
+			icons[i].point.x = static_cast<int32_t>((i % 64) * 75);
+			icons[i].point.y = static_cast<int32_t>((i / 64) * 100);
+		}
+
+		return icons;
+	}
+
+	/**
+	 * Write a locations file the way saving did before the streaming writer.
+	 * @param Desktop icons.
+	 * @return Contents of the locations file.
+	 */
+	std::string write_locations_dom(const std::vector<ds::DesktopIcon>& icons)
+	{
+		json icon_info = {};
+		icon_info["icons"] = json::array();
+		for (size_t i = 0; i < icons.size(); ++i)
+		{
+			icon_info["icons"][i]["name"] = icons[i].name;
+			icon_info["icons"][i]["location"][0] = icons[i].point.x;
+			icon_info["icons"][i]["location"][1] = icons[i].point.y;
+		}
+
+		return icon_info.dump(4);
+	}
+
+	/**
+	 * Read a locations file the way loading did before the pull parser.
+	 * @param Contents of the locations file.
+	 * @return Desktop icons.
+	 */
+	std::vector<ds::DesktopIcon> read_locations_dom(const std::string& text)
+	{
+		const json icon_info = json::parse(text);
+
+		const json& saved = icon_info["icons"];
+		std::vector<ds::DesktopIcon> icons(saved.size());
+		for (size_t i = 0; i < saved.size(); ++i)
+		{
+			icons[i].name = saved[i]["name"].get<std::string>();
+			icons[i].point.x = saved[i]["location"][0];
+			icons[i].point.y = saved[i]["location"][1];
+		}
+
+		return icons;
+	}
+
+	/**
+	 * Build and parse a manifest document the way a save does.
+	 * @tparam JSON document type.
+	 * @param Desktop icons.
+	 * @return Number of entries read back.
+	 */
+	template<typename Json>
+	size_t round_trip_manifest(const std::vector<ds::DesktopIcon>& icons)
+	{
+		Json j = {};
+		j["entries"] = Json::array();
+		for (const auto& icon : icons)
+		{
+			Json e = {};
+			e["name"] = icon.name;
+			e["id"] = 1234567;
+			e["size"] = 4096;
+			e["modified"] = 1700000000;
+			e["directory"] = false;
+			e["location"][0] = icon.point.x;
+			e["location"][1] = icon.point.y;
+			j["entries"].push_back(std::move(e));
+		}
+
+		const Json read = Json::parse(j.dump(4));
+		size_t entries = 0;
+		for (const auto& e : read["entries"])
+			entries += e["name"].template get<std::string>().empty() ? 0 : 1;
+
+		return entries;
+	}
+
+	/**
+	 * Match icons the way layout restore did before it was indexed.
+	 * @param Saved layout.
+	 * @param Enumerated icons.
+	 * @return Number of icons matched.
+	 */
+	size_t match_linear(json icon_info, const std::vector<ds::DesktopIcon>& items)
+	{
+		size_t matched = 0;
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			for (size_t j = 0; j < icon_info["icons"].size(); ++j)
+			{
+				const auto& icon = icon_info["icons"][j];
+				if (std::strcmp(icon["name"].get<std::string>().c_str(), items[i].name.c_str()) == 0)
+				{
+					++matched;
+					icon_info["icons"].erase(j);
+					break;
+				}
+			}
+		}
+
+		return matched;
+	}
+
+	/**
+	 * Match icons through a layout index.
+	 * @param Saved icons.
+	 * @param Enumerated icons.
+	 * @return Number of icons matched.
+	 */
+	size_t match_indexed(const std::vector<ds::DesktopIcon>& saved, const std::vector<ds::DesktopIcon>& items)
+	{
+		ds::LayoutIndex index(saved);
+
+		size_t matched = 0;
+		for (const auto& item : items)
+		{
+			ds::IconPoint point = {};
+			if (index.take(item.name, point))
+				++matched;
+		}
+
+		return matched;
+	}
+
+	/**
+	 * Compare layout restore with and without the index.
+	 */
+	void bench_layout_restore()
+	{
+		std::printf("layout restore (1 in 10 names duplicated)\n");
+		std::printf("%10s %14s %14s\n", "icons", "linear ms", "indexed ms");
+
+		std::mt19937 rng(42);
+		for (size_t count : { 100, 1000, 5000, 10000, 50000 })
+		{
+			const auto saved = make_icons(count, 10);
+
+			// The shell enumerates in its own order
+			auto items = saved;
+			std::shuffle(items.begin(), items.end(), rng);
+
+			json icon_info = {};
+			icon_info["icons"] = json::array();
+			for (const auto& icon : saved)
+				icon_info["icons"].push_back({ { "name", icon.name }, { "location", { icon.point.x, icon.point.y } } });
+
+			size_t matched = 0;
+			const double indexed = time_ms([&] { matched = match_indexed(saved, items); });
+
+			// The old matching is quadratic, so the biggest desktops would take minutes
+			if (count <= 5000)
+			{
+				const double linear = time_ms([&] { match_linear(icon_info, items); });
+				std::printf("%10zu %14.2f %14.2f\n", count, linear, indexed);
+			}
+			else std::printf("%10zu %14s %14.2f\n", count, "-", indexed);
+
+			if (matched != count)
+				std::printf("  only matched %zu icons\n", matched);
+		}
+	}
+
+	/**
+	 * Compare writing locations files through a JSON document with the streaming writer.
+	 */
+	void bench_locations_writer()
+	{
+		std::printf("\nlocations.json writer\n");
+		std::printf("%10s %8s %10s %10s %12s %12s\n", "icons", "writer", "ms", "allocs", "bytes", "peak bytes");
+
+		for (size_t count : { 10, 1000, 10000 })
+		{
+			auto icons = make_icons(count, 0);
+
+			// Names that need escaping
+			if (count > 3)
+			{
+				icons[1].name = "Quote \" and \\ back\tslash";
+				icons[2].name = "Control \x01\x1f";
+				icons[3].name = "UTF-8 \xc3\xa9\xe2\x82\xac";
+				icons[3].point.x = -2147483647 - 1;
+			}
+
+			std::string dom = {};
+			std::string streamed = {};
+			double dom_ms = 0.0;
+			double streamed_ms = 0.0;
+			const AllocStats dom_allocs = count_allocations([&] { dom_ms = time_ms([&] { dom = write_locations_dom(icons); }); });
+			const AllocStats streamed_allocs = count_allocations([&] { streamed_ms = time_ms([&] { streamed = ds::write_locations_json(icons); }); });
+
+			std::printf("%10zu %8s %10.2f %10zu %12zu %12zu\n", count, "dom", dom_ms, dom_allocs.count, dom_allocs.bytes, dom_allocs.peak);
+			std::printf("%10s %8s %10.2f %10zu %12zu %12zu\n", "", "stream", streamed_ms, streamed_allocs.count, streamed_allocs.bytes, streamed_allocs.peak);
+
+			if (dom != streamed)
+				std::printf("  output differs from json::dump(4)\n");
+		}
+	}
+
+	/**
+	 * Compare reading locations files through a JSON document with the pull parser.
+	 */
+	void bench_locations_parser()
+	{
+		std::printf("\nlocations.json parser\n");
+		std::printf("%10s %8s %10s %10s %10s %12s\n", "icons", "parser", "ms", "MB/s", "allocs", "bytes");
+
+		for (size_t count : { 10, 1000, 10000, 100000 })
+		{
+			auto icons = make_icons(count, 0);
+			if (count > 2)
+			{
+				icons[1].name = "Quote \" and \\ back\tslash";
+				icons[2].name = "UTF-8 \xc3\xa9\xe2\x82\xac";
+			}
+			const std::string text = ds::write_locations_json(icons);
+
+			std::vector<ds::DesktopIcon> dom = {};
+			std::vector<ds::DesktopIcon> pulled = {};
+			double dom_ms = 0.0;
+			double pulled_ms = 0.0;
+			const AllocStats dom_allocs = count_allocations([&] { dom_ms = time_ms([&] { dom = read_locations_dom(text); }); });
+			const AllocStats pulled_allocs = count_allocations([&] { pulled_ms = time_ms([&] { ds::read_locations_json(text.data(), text.size(), pulled); }); });
+
+			const double mb = static_cast<double>(text.size()) / (1024.0 * 1024.0);
+			std::printf("%10zu %8s %10.2f %10.1f %10zu %12zu\n", count, "dom", dom_ms, mb / (dom_ms / 1000.0), dom_allocs.count, dom_allocs.bytes);
+			std::printf("%10s %8s %10.2f %10.1f %10zu %12zu\n", "", "pull", pulled_ms, mb / (pulled_ms / 1000.0), pulled_allocs.count, pulled_allocs.bytes);
+
+			bool same = dom.size() == pulled.size();
+			for (size_t i = 0; same && i < dom.size(); ++i)
+				same = dom[i].name == pulled[i].name && dom[i].point.x == pulled[i].point.x && dom[i].point.y == pulled[i].point.y;
+			if (!same)
+				std::printf("  icons differ from json::parse\n");
+		}
+	}
+
+	/**
+	 * Compare JSON documents on the heap with documents in an arena.
+	 */
+	void bench_json_arena()
+	{
+		std::printf("\nmanifest document (write, dump, parse)\n");
+		std::printf("%10s %8s %10s %10s %12s\n", "entries", "alloc", "ms", "allocs", "bytes");
+
+		for (size_t count : { 10, 1000, 10000, 100000 })
+		{
+			const auto icons = make_icons(count, 0);
+
+			size_t heap_entries = 0;
+			size_t arena_entries = 0;
+			double heap_ms = 0.0;
+			double arena_ms = 0.0;
+			const AllocStats heap_allocs = count_allocations([&] { heap_ms = time_ms([&] { heap_entries = round_trip_manifest<json>(icons); }); });
+			const AllocStats arena_allocs = count_allocations([&] { arena_ms = time_ms([&]
+			{
+				ds::JsonArena arena;
+				arena_entries = round_trip_manifest<ds::arena_json>(icons);
+			}); });
+
+			std::printf("%10zu %8s %10.2f %10zu %12zu\n", count, "heap", heap_ms, heap_allocs.count, heap_allocs.bytes);
+			std::printf("%10s %8s %10.2f %10zu %12zu\n", "", "arena", arena_ms, arena_allocs.count, arena_allocs.bytes);
+
+			if (heap_entries != count || arena_entries != count)
+				std::printf("  read back %zu and %zu entries\n", heap_entries, arena_entries);
+		}
+	}
+
+#if !defined(_WIN32)
+	/**
+	 * Compare positioning icons one at a time with positioning them in batches.
+	 */
+	void bench_icon_positioning()
+	{
+		std::printf("\nicon positioning (simulated view)\n");
+		std::printf("%10s %14s %14s %14s %14s\n", "icons", "single calls", "single ms", "batched calls", "batched ms");
+
+		for (size_t count : { 100, 1000, 10000 })
+		{
+			char folder[] = "/tmp/ds_bench_XXXXXX";
+			if (mkdtemp(folder) == nullptr) return;
+
+			const std::string desktop_path = ds::join_path(folder, "Desktop");
+			const std::string positions_path = ds::join_path(folder, "positions.json");
+			{
+				ds::LinuxDesktopBackend backend(desktop_path, positions_path);
+				for (size_t i = 0; i < count; ++i)
+					std::ofstream(ds::join_path(desktop_path, "Icon " + std::to_string(i) + ".lnk"));
+
+				const auto icons = backend.get_icons();
+				std::vector<ds::IconPlacement> placements(icons.size());
+				for (size_t i = 0; i < icons.size(); ++i)
+				{
+					placements[i].item = i;
+					placements[i].point.x = static_cast<int32_t>((i % 64) * 75);
+					placements[i].point.y = static_cast<int32_t>((i / 64) * 100);
+				}
+
+				const double single = time_ms([&]
+				{
+					for (const auto& placement : placements)
+						backend.set_icon_position(placement.item, placement.point);
+				});
+				const size_t single_calls = backend.get_position_call_count();
+
+				const double batched = time_ms([&] { backend.set_icon_positions(placements); });
+				const size_t batched_calls = backend.get_position_call_count() - single_calls;
+
+				std::printf("%10zu %14zu %14.2f %14zu %14.2f\n", count, single_calls, single, batched_calls, batched);
+
+				for (const auto& name : backend.list_files(desktop_path))
+					std::remove(ds::join_path(desktop_path, name).c_str());
+			}
+
+			std::remove(positions_path.c_str());
+			rmdir(desktop_path.c_str());
+			rmdir(folder);
+		}
+	}
+
+	/**
+	 * Compare looking up saved desktops by scanning with the catalog.
+	 */
+	void bench_catalog_lookup()
+	{
+		std::printf("\ndesktop lookup (10000 lookups)\n");
+		std::printf("%10s %14s %14s %14s %14s\n", "desktops", "scan ms", "scan allocs", "catalog ms", "catalog allocs");
+
+		char folder[] = "/tmp/ds_bench_XXXXXX";
+		if (mkdtemp(folder) == nullptr) return;
+
+		const std::string desktop_path = ds::join_path(folder, "Desktop");
+		{
+			ds::LinuxDesktopBackend backend(desktop_path, ds::join_path(folder, "positions.json"));
+			ds::MoveEngine move_engine(backend, 1);
+
+			for (size_t count : { 10, 100, 1000, 10000 })
+			{
+				// Saved desktops don't touch the disk until they're used
+				std::vector<ds::SavedDesktop> desktops = {};
+				ds::DesktopCatalog catalog = {};
+				std::vector<std::string> names(count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					names[i] = "Project desktop " + std::to_string(i);
+					desktops.push_back(ds::SavedDesktop(names[i], ds::join_path(folder, names[i]), backend, move_engine));
+					catalog.add(desktops.back());
+				}
+
+				std::mt19937 rng(42);
+				std::vector<size_t> lookups(10000);
+				for (auto& lookup : lookups)
+					lookup = rng() % count;
+
+				// The old lookup compared against a copy of every name
+				size_t scan_found = 0;
+				double scan_ms = 0.0;
+				const AllocStats scan_allocs = count_allocations([&] { scan_ms = time_ms([&]
+				{
+					for (const size_t lookup : lookups)
+						for (const auto& desktop : desktops)
+							if (std::string(desktop.get_name()) == names[lookup])
+							{
+								++scan_found;
+								break;
+							}
+				}); });
+
+				size_t catalog_found = 0;
+				double catalog_ms = 0.0;
+				const AllocStats catalog_allocs = count_allocations([&] { catalog_ms = time_ms([&]
+				{
+					for (const size_t lookup : lookups)
+						catalog_found += catalog.find(ds::make_name_ref(names[lookup])) != nullptr ? 1 : 0;
+				}); });
+
+				std::printf("%10zu %14.2f %14zu %14.2f %14zu\n", count, scan_ms, scan_allocs.count, catalog_ms, catalog_allocs.count);
+
+				if (scan_found != lookups.size() || catalog_found != lookups.size())
+					std::printf("  found %zu and %zu desktops\n", scan_found, catalog_found);
+			}
+		}
+
+		std::remove(ds::join_path(folder, "positions.json").c_str());
+		rmdir(desktop_path.c_str());
+		rmdir(folder);
+	}
+
+	/**
+	 * Linux backend that counts the filesystem calls made through it.
+	 */
+	class CountingBackend : public ds::LinuxDesktopBackend
+	{
+	public:
+
+		using ds::LinuxDesktopBackend::LinuxDesktopBackend;
+
+		std::vector<std::string> list_files(const std::string& path) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::list_files(path);
+		}
+
+		bool move_file(const std::string& from, const std::string& to) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::move_file(from, to);
+		}
+
+		bool replace_file(const std::string& from, const std::string& to) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::replace_file(from, to);
+		}
+
+		bool sync_file(const std::string& path) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::sync_file(path);
+		}
+
+		bool sync_directory(const std::string& path) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::sync_directory(path);
+		}
+
+		bool exchange_directories(const std::string& a, const std::string& b) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::exchange_directories(a, b);
+		}
+
+		bool same_filesystem(const std::string& a, const std::string& b) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::same_filesystem(a, b);
+		}
+
+		bool get_file_info(const std::string& path, ds::FileInfo& info) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::get_file_info(path, info);
+		}
+
+		bool create_directory(const std::string& path) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::create_directory(path);
+		}
+
+		bool file_exists(const std::string& path) override
+		{
+			++m_calls;
+			return ds::LinuxDesktopBackend::file_exists(path);
+		}
+
+		/**
+		 * Get the number of filesystem calls so far.
+		 * @return Call count.
+		 */
+		size_t get_call_count() const noexcept
+		{
+			return m_calls;
+		}
+
+	private:
+
+		/** Filesystem calls, which move workers make too. */
+		std::atomic<size_t> m_calls{ 0 };
+	};
+
+	/**
+	 * Read and write system calls and bytes written by the process so far.
+	 */
+	struct IoStats
+	{
+		/** Read and write system calls. */
+		size_t syscalls = 0;
+
+		/** Bytes passed to write system calls. */
+		size_t bytes_written = 0;
+	};
+
+	/**
+	 * Read the I/O accounting of the process.
+	 * @return I/O statistics, all zero if the kernel doesn't keep them.
+	 */
+	IoStats read_io_stats()
+	{
+		IoStats stats = {};
+		std::ifstream stream("/proc/self/io");
+		std::string key = {};
+		size_t value = 0;
+		while (stream >> key >> value)
+		{
+			if (key == "syscr:" || key == "syscw:") stats.syscalls += value;
+			else if (key == "wchar:") stats.bytes_written = value;
+		}
+
+		return stats;
+	}
+
+	/**
+	 * Measurements of one phase of a switch.
+	 */
+	struct PhaseStats
+	{
+		/** Name. */
+		const char* name = "";
+
+		/** Latency of every run. */
+		std::vector<double> ms = {};
+
+		/** Filesystem calls through the backend, over every run. */
+		size_t calls = 0;
+
+		/** Read and write system calls, over every run. */
+		size_t syscalls = 0;
+
+		/** Allocations, over every run. */
+		size_t allocs = 0;
+
+		/** Bytes written, over every run. */
+		size_t bytes_written = 0;
+	};
+
+	/**
+	 * Run a phase and add its cost to the phase statistics.
+	 * @param Phase statistics.
+	 * @param Backend the phase runs against.
+	 * @param Phase.
+	 */
+	template<typename F>
+	void measure_phase(PhaseStats& phase, const CountingBackend& backend, F&& f)
+	{
+		const size_t calls = backend.get_call_count();
+		const IoStats io = read_io_stats();
+
+		double ms = 0.0;
+		const AllocStats allocs = count_allocations([&] { ms = time_ms(f); });
+
+		const IoStats io_after = read_io_stats();
+		phase.ms.push_back(ms);
+		phase.calls += backend.get_call_count() - calls;
+		phase.syscalls += io_after.syscalls - io.syscalls;
+		phase.allocs += allocs.count;
+		phase.bytes_written += io_after.bytes_written - io.bytes_written;
+	}
+
+	/**
+	 * Get a percentile of some latencies.
+	 * @param Latencies.
+	 * @param Percentile, from 0 to 1.
+	 * @return Nearest rank latency.
+	 */
+	double percentile(std::vector<double> ms, double p)
+	{
+		std::sort(ms.begin(), ms.end());
+		const size_t rank = static_cast<size_t>(p * static_cast<double>(ms.size()) + 0.999999);
+		return ms[std::min(ms.size(), std::max<size_t>(rank, 1)) - 1];
+	}
+
+	/**
+	 * Remove a file or folder, for nftw.
+	 * @return 0 to keep going.
+	 */
+	int remove_entry(const char* path, const struct stat*, int, struct FTW*)
+	{
+		std::remove(path);
+		return 0;
+	}
+
+	/**
+	 * Time every phase of a switch on simulated desktops of different sizes.
+	 * @note DS_BENCH_MAX_ENTRIES limits the biggest desktop.
+	 * @note DS_VIEW_DELAY_MS sets how far the view lags behind for "load lagged", 5 ms by default.
+	 */
+	void bench_switch_scale()
+	{
+		size_t max_entries = 100000;
+		if (const char* max = std::getenv("DS_BENCH_MAX_ENTRIES"))
+			max_entries = static_cast<size_t>(std::strtoull(max, nullptr, 10));
+
+		long view_delay = 5;
+		if (const char* delay = std::getenv("DS_VIEW_DELAY_MS"))
+			view_delay = std::strtol(delay, nullptr, 10);
+
+		std::printf("\nswitch phases (simulated view, costs per run)\n");
+		std::printf("%10s %14s %10s %10s %10s %10s %10s %10s %12s\n", "entries", "phase", "p50 ms", "p90 ms", "max ms", "fs calls", "io calls", "allocs", "bytes out");
+
+		for (size_t count : { 10, 1000, 10000, 100000 })
+		{
+			if (count > max_entries) break;
+			const size_t runs = count <= 10 ? 20 : count <= 1000 ? 10 : count <= 10000 ? 5 : 3;
+
+			char folder[] = "/tmp/ds_bench_XXXXXX";
+			if (mkdtemp(folder) == nullptr) return;
+
+			const std::string desktop_path = ds::join_path(folder, "Desktop");
+			const std::string data_path = ds::join_path(folder, "Desktop-Saver");
+			const std::string journal_path = ds::join_path(data_path, "journal.jsonl");
+
+			PhaseStats phases[5] = {};
+			phases[0].name = "save";
+			phases[1].name = "load";
+			phases[2].name = "new_desktop";
+			phases[3].name = "load_desktop";
+			phases[4].name = "load lagged";
+			{
+				CountingBackend backend(desktop_path, ds::join_path(folder, "positions.json"));
+				CountingBackend lagged(desktop_path, ds::join_path(folder, "positions-lagged.json"), std::chrono::milliseconds(view_delay));
+				for (size_t i = 0; i < count; ++i)
+					std::ofstream(ds::join_path(desktop_path, "File " + std::to_string(i) + ".txt")) << i;
+
+				backend.create_directory(ds::join_path(data_path, "saves"));
+				std::ofstream(ds::join_path(data_path, "saves.json")) << "{ \"active_desktop\" : \"Default\", \"saves\" : [ \"Default\" ] }";
+
+				ds::MoveEngine move_engine(backend);
+				ds::SaveData save_data(data_path, backend, move_engine);
+
+				// The default save, seen through the lagging view
+				ds::MoveEngine lagged_engine(lagged);
+				ds::SavedDesktop lagged_default("Default", ds::join_path(ds::join_path(data_path, "saves"), "Default"), lagged, lagged_engine);
+
+				for (size_t run = 0; run < runs; ++run)
+				{
+					// Move the desktop into the active save and back, the way a switch does
+					ds::SavedDesktop& active = save_data.get_active_desktop();
+					measure_phase(phases[0], backend, [&]
+					{
+						ds::SwitchJournal journal(backend, journal_path);
+						ds::CommitGroup commit(backend);
+						const ds::SavePlan plan = active.plan_save(journal);
+						journal.flush();
+						active.save(plan, commit);
+						commit.commit();
+						journal.finish();
+					});
+					measure_phase(phases[1], backend, [&]
+					{
+						ds::SwitchJournal journal(backend, journal_path);
+						ds::CommitGroup commit(backend);
+						ds::LoadPlan plan = active.plan_load(journal);
+						journal.flush();
+						active.load(plan, commit);
+						commit.commit();
+						journal.finish();
+					});
+
+					// Save into a new desktop, then swap the old one back in
+					measure_phase(phases[2], backend, [&] { save_data.new_desktop("Bench " + std::to_string(run)); });
+					measure_phase(phases[3], backend, [&] { save_data.load_desktop("Default"); });
+
+					// Save again, then load through a view that only notices the files over several passes
+					{
+						ds::SwitchJournal journal(backend, journal_path);
+						ds::CommitGroup commit(backend);
+						const ds::SavePlan plan = save_data.get_active_desktop().plan_save(journal);
+						journal.flush();
+						save_data.get_active_desktop().save(plan, commit);
+						commit.commit();
+						journal.finish();
+					}
+					measure_phase(phases[4], lagged, [&]
+					{
+						ds::SwitchJournal journal(lagged, journal_path);
+						ds::CommitGroup commit(lagged);
+						ds::LoadPlan plan = lagged_default.plan_load(journal);
+						journal.flush();
+						lagged_default.load(plan, commit);
+						commit.commit();
+						journal.finish();
+					});
+				}
+
+				if (backend.list_files(desktop_path).size() != count)
+					std::printf("  desktop ended up with %zu files\n", backend.list_files(desktop_path).size());
+			}
+
+			for (const auto& phase : phases)
+			{
+				std::printf("%10zu %14s %10.2f %10.2f %10.2f %10zu %10zu %10zu %12zu\n", count, phase.name,
+					percentile(phase.ms, 0.5), percentile(phase.ms, 0.9), percentile(phase.ms, 1.0),
+					phase.calls / runs, phase.syscalls / runs, phase.allocs / runs, phase.bytes_written / runs);
+			}
+
+			nftw(folder, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+		}
+	}
+
+	/**
+	 * Time moving files from a RAM disk onto the disk, which has to copy them.
+	 * @note Skipped if /dev/shm and /tmp are the same filesystem.
+	 */
+	void bench_cross_filesystem_move()
+	{
+		char source[] = "/dev/shm/ds_bench_XXXXXX";
+		char target[] = "/tmp/ds_bench_XXXXXX";
+		if (mkdtemp(source) == nullptr) return;
+		if (mkdtemp(target) == nullptr)
+		{
+			rmdir(source);
+			return;
+		}
+
+		std::printf("\ncross filesystem move (/dev/shm to /tmp, copied and verified)\n");
+		{
+			ds::LinuxDesktopBackend backend(source, ds::join_path(target, "positions.json"));
+			if (backend.same_filesystem(source, target))
+				std::printf("  skipped, both are on the same filesystem\n");
+			else
+			{
+				std::printf("%10s %12s %10s %10s %10s\n", "files", "file size", "copied", "ms", "MB/s");
+
+				ds::MoveEngine move_engine(backend);
+				std::mt19937 random(7);
+				const std::pair<size_t, size_t> cases[] = { { 1000, 4 << 10 }, { 16, 16 << 20 }, { 1, 256 << 20 } };
+				for (const auto& c : cases)
+				{
+					// Random data, so nothing along the way can cheat by compressing it
+					std::vector<uint32_t> data(c.second / sizeof(uint32_t));
+					for (auto& word : data) word = random();
+
+					std::vector<ds::FileMove> moves(c.first);
+					for (size_t i = 0; i < c.first; ++i)
+					{
+						const std::string name = "File " + std::to_string(i) + ".bin";
+						moves[i].from = ds::join_path(source, name);
+						moves[i].to = ds::join_path(target, name);
+						std::ofstream(moves[i].from, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), c.second);
+					}
+
+					const ds::MoveReport report = move_engine.run(moves);
+					std::printf("%10zu %12zu %10zu %10.2f %10.1f\n", c.first, c.second, report.copied_count,
+						report.seconds * 1000.0, report.get_copied_bytes_per_second() / (1 << 20));
+
+					for (const auto& move : moves)
+						std::remove(move.to.c_str());
+				}
+			}
+		}
+
+		nftw(source, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+		nftw(target, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	}
+
+	/**
+	 * Time cloning a desktop folder next to itself, the way a desktop clone does.
+	 */
+	void bench_desktop_clone()
+	{
+		char folder[] = "/tmp/ds_bench_XXXXXX";
+		if (mkdtemp(folder) == nullptr) return;
+
+		const std::string desktop_path = ds::join_path(folder, "Desktop");
+
+		std::printf("\ndesktop clone (%s)\n", folder);
+		std::printf("%10s %12s %10s %10s %10s %10s\n", "files", "file size", "reflinked", "linked", "copied", "ms");
+		{
+			ds::LinuxDesktopBackend backend(desktop_path, ds::join_path(folder, "positions.json"));
+
+			const std::vector<char> data(1 << 20, 'x');
+			for (size_t count : { 100, 1000, 10000 })
+			{
+				for (size_t i = 0; i < count; ++i)
+					std::ofstream(ds::join_path(desktop_path, "File " + std::to_string(i) + ".bin"), std::ios::binary).write(data.data(), count <= 1000 ? data.size() : 4096);
+
+				ds::CloneStats stats = {};
+				const std::string clone_path = ds::join_path(folder, "Clone");
+				bool cloned = false;
+				const double ms = time_ms([&] { cloned = backend.clone_file(desktop_path, clone_path, stats); });
+				if (!cloned) std::printf("  clone failed\n");
+
+				std::printf("%10zu %12zu %10zu %10zu %10zu %10.2f\n", count, count <= 1000 ? data.size() : size_t(4096),
+					stats.reflinked, stats.linked, stats.copied, ms);
+
+				nftw(clone_path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+			}
+		}
+
+		nftw(folder, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	}
+#endif
+}
+
+void* operator new(std::size_t size)
+{
+	char* block = static_cast<char*>(std::malloc(size + alloc_header));
+	if (block == nullptr) throw std::bad_alloc();
+
+	std::memcpy(block, &size, sizeof(size));
+	++g_alloc_count;
+	g_alloc_bytes += size;
+
+	// Track the high water mark
+	const size_t live = g_live_bytes += size;
+	size_t peak = g_peak_bytes;
+	while (live > peak && !g_peak_bytes.compare_exchange_weak(peak, live)) {}
+
+	return block + alloc_header;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr == nullptr) return;
+
+	char* block = static_cast<char*>(ptr) - alloc_header;
+	size_t size = 0;
+	std::memcpy(&size, block, sizeof(size));
+	g_live_bytes -= size;
+
+	std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+/**
+ * Entry point.
+ * @param Number of arguments passed.
+ * @param Names of the benchmarks to run, or none to run them all.
+ */
+int main(int argc, char* argv[])
+{
+	const auto wanted = [&](const char* name)
+	{
+		if (argc < 2) return true;
+		for (int i = 1; i < argc; ++i)
+			if (std::strcmp(argv[i], name) == 0)
+				return true;
+		return false;
+	};
+
+	if (wanted("restore")) bench_layout_restore();
+	if (wanted("writer")) bench_locations_writer();
+	if (wanted("parser")) bench_locations_parser();
+	if (wanted("arena")) bench_json_arena();
+#if !defined(_WIN32)
+	if (wanted("positioning")) bench_icon_positioning();
+	if (wanted("catalog")) bench_catalog_lookup();
+	if (wanted("switch")) bench_switch_scale();
+	if (wanted("copy")) bench_cross_filesystem_move();
+	if (wanted("clone")) bench_desktop_clone();
+#endif
+	return 0;
+}
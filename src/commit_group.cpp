@@ -0,0 +1,68 @@
+/**
+ * @file commit_group.cpp
+ * @brief Commit group source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "commit_group.hpp"
+#include "trace.hpp"
+
+namespace ds
+{
+	CommitGroup::CommitGroup(DesktopBackend& backend) : m_backend(backend)
+	{
+
+	}
+
+	CommitGroup::~CommitGroup()
+	{
+		for (const auto& file : m_files)
+			std::remove(file.first.c_str());
+	}
+
+	void CommitGroup::touch_directory(const std::string& path)
+	{
+		m_directories.insert(path);
+	}
+
+	void CommitGroup::write_file(const std::string& path, const std::string& contents)
+	{
+		const std::string temp = path + ".tmp";
+
+		// Write the contents beside the real file
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		stream << contents;
+		stream.close();
+		if (!stream) throw std::runtime_error("Unable to write " + path);
+
+		m_files.emplace_back(temp, path);
+	}
+
+	void CommitGroup::commit()
+	{
+		DS_TRACE_SCOPE("CommitGroup::commit");
+
+		// File contents have to be on disk before the renames that publish them
+		for (const auto& file : m_files)
+			m_backend.sync_file(file.first);
+
+		// Publish the files
+		for (const auto& file : m_files)
+		{
+			if (!m_backend.replace_file(file.first, file.second))
+				throw std::runtime_error("Unable to replace " + file.second);
+
+			m_directories.insert(get_parent_path(file.second));
+		}
+		m_files.clear();
+
+		// One barrier per folder covers every rename in it
+		for (const auto& directory : m_directories)
+			m_backend.sync_directory(directory);
+		m_directories.clear();
+	}
+}
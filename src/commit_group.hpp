@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * @file commit_group.hpp
+ * @brief Commit group header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "desktop_backend.hpp"
+
+namespace ds
+{
+	/**
+	 * Collects the writes of one operation so they can be made durable together.
+	 * Files are written next to their destination and renamed into place on commit, after their
+	 * data is on disk, so every file is either fully old or fully new after a crash.
+	 */
+	class CommitGroup
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Desktop backend.
+		 */
+		explicit CommitGroup(DesktopBackend& backend);
+
+		/**
+		 * Destructor.
+		 * @note Uncommitted writes are thrown away.
+		 */
+		~CommitGroup();
+
+		CommitGroup(const CommitGroup&) = delete;
+		CommitGroup& operator=(const CommitGroup&) = delete;
+
+		/**
+		 * Note that entries in a folder were created, moved or removed.
+		 * @param Folder path.
+		 */
+		void touch_directory(const std::string& path);
+
+		/**
+		 * Stage a file to be replaced on commit.
+		 * @param File path.
+		 * @param New contents.
+		 */
+		void write_file(const std::string& path, const std::string& contents);
+
+		/**
+		 * Make every staged file and touched folder durable.
+		 * Issues one flush per staged file and one per touched folder.
+		 */
+		void commit();
+
+	private:
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+
+		/** Staged files as (temporary path, final path). */
+		std::vector<std::pair<std::string, std::string>> m_files = {};
+
+		/** Touched folders. */
+		std::set<std::string> m_directories = {};
+	};
+}
@@ -0,0 +1,451 @@
+/**
+ * @file daemon.cpp
+ * @brief Resident daemon source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "daemon.hpp"
+#include "util.hpp"
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+namespace
+{
+	/** Largest frame either end accepts. */
+	constexpr uint32_t max_frame_size = 16 * 1024 * 1024;
+
+	/** Longest the daemon waits on a client that stopped sending or receiving. */
+	constexpr time_t client_timeout_seconds = 5;
+
+	/** Don't die of SIGPIPE when the other end goes away. */
+#if defined(MSG_NOSIGNAL)
+	constexpr int send_flags = MSG_NOSIGNAL;
+#else
+	constexpr int send_flags = 0;
+#endif
+
+	/**
+	 * Write every byte.
+	 * @param Socket.
+	 * @param Data.
+	 * @param Size in bytes.
+	 * @return If everything was written.
+	 */
+	bool write_all(int fd, const char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			const ssize_t written = ::send(fd, data, size, send_flags);
+			if (written < 0 && errno == EINTR) continue;
+			if (written <= 0) return false;
+
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Read exactly some number of bytes.
+	 * @param Socket.
+	 * @param Buffer.
+	 * @param Size in bytes.
+	 * @return If everything was read.
+	 */
+	bool read_all(int fd, char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			const ssize_t got = ::recv(fd, data, size, 0);
+			if (got < 0 && errno == EINTR) continue;
+			if (got <= 0) return false;
+
+			data += got;
+			size -= static_cast<size_t>(got);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Append a 32 bit integer.
+	 * @param Buffer.
+	 * @param Integer.
+	 */
+	void append_u32(std::string& out, uint32_t value)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	/**
+	 * Append a length prefixed string.
+	 * @param Buffer.
+	 * @param String.
+	 */
+	void append_string(std::string& out, const std::string& str)
+	{
+		append_u32(out, static_cast<uint32_t>(str.size()));
+		out += str;
+	}
+
+	/**
+	 * Reads the fields of a frame.
+	 */
+	struct FrameReader
+	{
+		/** Next byte. */
+		const char* pos;
+
+		/** End of the frame. */
+		const char* end;
+
+		/**
+		 * Read a 32 bit integer.
+		 * @param Integer.
+		 * @return If the frame was long enough.
+		 */
+		bool read_u32(uint32_t& value)
+		{
+			if (static_cast<size_t>(end - pos) < sizeof(value)) return false;
+			std::memcpy(&value, pos, sizeof(value));
+			pos += sizeof(value);
+			return true;
+		}
+
+		/**
+		 * Read a length prefixed string.
+		 * @param String.
+		 * @return If the frame was long enough.
+		 */
+		bool read_string(std::string& str)
+		{
+			uint32_t size = 0;
+			if (!read_u32(size) || static_cast<size_t>(end - pos) < size) return false;
+			str.assign(pos, size);
+			pos += size;
+			return true;
+		}
+	};
+
+	/**
+	 * Send a frame.
+	 * @param Socket.
+	 * @param Frame contents.
+	 * @return If the frame was sent.
+	 */
+	bool write_frame(int fd, const std::string& frame)
+	{
+		std::string out = {};
+		out.reserve(sizeof(uint32_t) + frame.size());
+		append_string(out, frame);
+		return write_all(fd, out.data(), out.size());
+	}
+
+	/**
+	 * Receive a frame.
+	 * @param Socket.
+	 * @param Frame contents.
+	 * @return If a whole frame arrived.
+	 */
+	bool read_frame(int fd, std::string& frame)
+	{
+		uint32_t size = 0;
+		if (!read_all(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > max_frame_size)
+			return false;
+
+		frame.resize(size);
+		return size == 0 || read_all(fd, &frame[0], size);
+	}
+
+	/**
+	 * Fill in a socket address.
+	 * @param Socket path.
+	 * @param Address.
+	 * @return If the path fits.
+	 */
+	bool make_address(const std::string& path, sockaddr_un& address)
+	{
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) return false;
+
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+
+	/**
+	 * Connect to a daemon.
+	 * @param Socket path.
+	 * @return Connection, or -1 if no daemon is listening.
+	 */
+	int connect_to(const std::string& path)
+	{
+		sockaddr_un address = {};
+		if (!make_address(path, address)) return -1;
+
+		const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) return -1;
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			::close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+}
+#endif
+
+namespace ds
+{
+#if defined(_WIN32)
+	Daemon::Daemon(const std::string& socket_path, CommandHandler handler) :
+		m_socket_path(socket_path),
+		m_handler(std::move(handler))
+	{
+		throw std::runtime_error("The daemon isn't supported on this platform");
+	}
+
+	Daemon::~Daemon()
+	{
+
+	}
+
+	void Daemon::run()
+	{
+
+	}
+
+	bool Daemon::send(const std::string&, const std::vector<std::string>&, CommandResult&)
+	{
+		return false;
+	}
+
+	bool Daemon::is_running(const std::string&)
+	{
+		return false;
+	}
+
+	bool Daemon::stop(const std::string&)
+	{
+		return false;
+	}
+
+	bool Daemon::serve(int)
+	{
+		return false;
+	}
+
+	std::string get_daemon_socket_path(const std::string& path)
+	{
+		return join_path(path, "daemon.sock");
+	}
+#else
+	Daemon::Daemon(const std::string& socket_path, CommandHandler handler) :
+		m_socket_path(socket_path),
+		m_handler(std::move(handler))
+	{
+		sockaddr_un address = {};
+		if (!make_address(m_socket_path, address))
+			throw std::runtime_error("The daemon socket path is too long");
+
+		// A socket nobody answers on was left behind by a daemon that was killed
+		const int existing = connect_to(m_socket_path);
+		if (existing >= 0)
+		{
+			::close(existing);
+			throw std::runtime_error("The daemon is already running");
+		}
+		::unlink(m_socket_path.c_str());
+
+		m_socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_socket < 0)
+			throw std::runtime_error("Unable to create the daemon socket");
+		fcntl(m_socket, F_SETFD, FD_CLOEXEC);
+
+		// Only this user may send commands
+		const mode_t mask = ::umask(0077);
+		const bool bound = ::bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+		::umask(mask);
+
+		if (!bound || ::listen(m_socket, 8) != 0)
+		{
+			::close(m_socket);
+			throw std::runtime_error("Unable to listen on the daemon socket");
+		}
+	}
+
+	Daemon::~Daemon()
+	{
+		// Already gone if the daemon was asked to stop
+		if (m_socket < 0) return;
+
+		::close(m_socket);
+		::unlink(m_socket_path.c_str());
+	}
+
+	void Daemon::run()
+	{
+		while (true)
+		{
+			const int connection = ::accept(m_socket, nullptr, nullptr);
+			if (connection < 0)
+			{
+				if (errno == EINTR || errno == ECONNABORTED) continue;
+				throw std::runtime_error("Unable to accept a daemon connection");
+			}
+
+			fcntl(connection, F_SETFD, FD_CLOEXEC);
+
+			// A client that hangs or sends garbage only loses its own connection
+			timeval timeout = {};
+			timeout.tv_sec = client_timeout_seconds;
+			setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+			bool serving = true;
+			try
+			{ serving = serve(connection); }
+			catch (...) {}
+			::close(connection);
+
+			if (!serving) return;
+		}
+	}
+
+	bool Daemon::send(const std::string& socket_path, const std::vector<std::string>& args, CommandResult& result)
+	{
+		const int connection = connect_to(socket_path);
+		if (connection < 0) return false;
+
+		std::string request = {};
+		append_u32(request, static_cast<uint32_t>(args.size()));
+		for (const auto& arg : args)
+			append_string(request, arg);
+
+		// The daemon may have started the command, so this counts as sent even if the reply is lost
+		std::string response = {};
+		uint32_t exit_code = 0;
+		FrameReader reader = {};
+		const bool replied = write_frame(connection, request) && read_frame(connection, response);
+		::close(connection);
+
+		reader.pos = response.data();
+		reader.end = response.data() + response.size();
+		if (!replied || !reader.read_u32(exit_code) || !reader.read_string(result.out) || !reader.read_string(result.err))
+		{
+			result.exit_code = 1;
+			result.err = "ERROR: Lost the connection to the daemon.";
+			return true;
+		}
+
+		result.exit_code = static_cast<int>(exit_code);
+		return true;
+	}
+
+	bool Daemon::is_running(const std::string& socket_path)
+	{
+		const int connection = connect_to(socket_path);
+		if (connection < 0) return false;
+
+		::close(connection);
+		return true;
+	}
+
+	bool Daemon::stop(const std::string& socket_path)
+	{
+		const int connection = connect_to(socket_path);
+		if (connection < 0) return false;
+
+		std::string request = {};
+		append_u32(request, 0);
+
+		std::string response = {};
+		const bool stopped = write_frame(connection, request) && read_frame(connection, response);
+		::close(connection);
+		return stopped;
+	}
+
+	bool Daemon::serve(int connection)
+	{
+		std::string request = {};
+		if (!read_frame(connection, request)) return true;
+
+		FrameReader reader = {};
+		reader.pos = request.data();
+		reader.end = request.data() + request.size();
+
+		uint32_t count = 0;
+		if (!reader.read_u32(count)) return true;
+
+		// Stop, removing the socket before answering so a new daemon can start right away
+		if (count == 0)
+		{
+			::close(m_socket);
+			::unlink(m_socket_path.c_str());
+			m_socket = -1;
+			write_frame(connection, "");
+			return false;
+		}
+
+		std::vector<std::string> args = {};
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			args.emplace_back();
+			if (!reader.read_string(args.back())) return true;
+		}
+
+		// A failed command mustn't take the daemon down with it
+		std::ostringstream out;
+		std::ostringstream err;
+		int exit_code = 0;
+		try
+		{ exit_code = m_handler(args, out, err); }
+		catch (const std::exception& e)
+		{
+			err << "ERROR: " << e.what();
+			exit_code = 1;
+		}
+		catch (...)
+		{
+			err << "ERROR: Unknown error.";
+			exit_code = 1;
+		}
+
+		std::string response = {};
+		append_u32(response, static_cast<uint32_t>(exit_code));
+		append_string(response, out.str());
+		append_string(response, err.str());
+		write_frame(connection, response);
+		return true;
+	}
+
+	std::string get_daemon_socket_path(const std::string& path)
+	{
+		// The runtime folder is private to the user and cleared on logout
+		const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+		if (runtime != nullptr && runtime[0] != '\0')
+			return join_path(runtime, "desktop-saver.sock");
+
+		return join_path(path, "daemon.sock");
+	}
+#endif
+}
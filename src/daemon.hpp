@@ -0,0 +1,124 @@
+#pragma once
+
+/**
+ * @file daemon.hpp
+ * @brief Resident daemon header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ds
+{
+	/**
+	 * Runs one command.
+	 * @param Command line arguments, without the program name.
+	 * @param Standard output.
+	 * @param Standard error.
+	 * @return Exit code.
+	 */
+	using CommandHandler = std::function<int(const std::vector<std::string>&, std::ostream&, std::ostream&)>;
+
+	/**
+	 * What a command printed and returned.
+	 */
+	struct CommandResult
+	{
+		/** Exit code. */
+		int exit_code = 0;
+
+		/** Standard output. */
+		std::string out = "";
+
+		/** Standard error. */
+		std::string err = "";
+	};
+
+	/**
+	 * Long running process that keeps the save data and the desktop backend warm and runs commands
+	 * sent to it over a local socket, one at a time.
+	 *
+	 * Every message is a frame: a 32 bit length followed by that many bytes.
+	 * A request frame holds a 32 bit argument count followed by each argument as a 32 bit length and its bytes.
+	 * A response frame holds a 32 bit exit code followed by the standard output and standard error the same way.
+	 * A request without arguments asks the daemon to stop, and gets an empty response once it has.
+	 * Integers are in host byte order, since both ends are on the same machine.
+	 */
+	class Daemon
+	{
+	public:
+
+		/**
+		 * Constructor. Starts listening.
+		 * @param Socket path.
+		 * @param Runs each command.
+		 * @note Throws if another daemon is already listening.
+		 */
+		Daemon(const std::string& socket_path, CommandHandler handler);
+
+		/**
+		 * Destructor. Stops listening and removes the socket.
+		 */
+		~Daemon();
+
+		Daemon(const Daemon&) = delete;
+		Daemon& operator=(const Daemon&) = delete;
+
+		/**
+		 * Serve commands until asked to stop.
+		 */
+		void run();
+
+		/**
+		 * Run a command in the daemon.
+		 * @param Socket path.
+		 * @param Command line arguments, without the program name.
+		 * @param What the command printed and returned.
+		 * @return If a daemon ran the command. If not, nothing was run.
+		 */
+		static bool send(const std::string& socket_path, const std::vector<std::string>& args, CommandResult& result);
+
+		/**
+		 * Check if a daemon is listening.
+		 * @param Socket path.
+		 * @return If a daemon answered.
+		 */
+		static bool is_running(const std::string& socket_path);
+
+		/**
+		 * Ask a daemon to stop.
+		 * @param Socket path.
+		 * @return If a daemon stopped.
+		 */
+		static bool stop(const std::string& socket_path);
+
+	private:
+
+		/**
+		 * Serve one connection.
+		 * @param Connection.
+		 * @return If the daemon should keep serving.
+		 */
+		bool serve(int connection);
+
+		/** Socket path. */
+		const std::string m_socket_path;
+
+		/** Runs each command. */
+		CommandHandler m_handler;
+
+		/** Listening socket. */
+		int m_socket = -1;
+	};
+
+	/**
+	 * Get the path of the daemon socket.
+	 * @param Path to Desktop-Saver folder.
+	 * @return Socket path.
+	 */
+	extern std::string get_daemon_socket_path(const std::string& path);
+}
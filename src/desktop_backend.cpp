@@ -0,0 +1,101 @@
+/**
+ * @file desktop_backend.cpp
+ * @brief Desktop backend source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include "desktop_backend.hpp"
+#include "trace.hpp"
+
+namespace
+{
+	/** First sleep between checks when nothing is happening. */
+	constexpr std::chrono::milliseconds min_backoff(1);
+
+	/** Longest sleep between checks when nothing is happening. */
+	constexpr std::chrono::milliseconds max_backoff(100);
+}
+
+namespace ds
+{
+	void DesktopBackend::refresh()
+	{
+		DS_TRACE_SCOPE("DesktopBackend::refresh");
+
+		++m_view_stats.refreshes;
+		refresh_view();
+
+		if (m_quiet_depth == 0)
+			++m_view_stats.repaints;
+	}
+
+	void DesktopBackend::begin_quiet_restore()
+	{
+		if (m_quiet_depth++ == 0)
+			set_view_redraw(false);
+	}
+
+	void DesktopBackend::end_quiet_restore()
+	{
+		if (m_quiet_depth == 0 || --m_quiet_depth != 0) return;
+
+		set_view_redraw(true);
+		++m_view_stats.repaints;
+	}
+
+	WaitReport DesktopBackend::wait_for_items(const std::function<bool(size_t)>& done, std::chrono::milliseconds timeout)
+	{
+		DS_TRACE_SCOPE("DesktopBackend::wait_for_items");
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto deadline = start + timeout;
+
+		WaitReport report = {};
+		std::chrono::milliseconds backoff = min_backoff;
+		for (;;)
+		{
+			report.item_count = get_item_count();
+			++report.checks;
+
+			if (done(report.item_count))
+			{
+				report.satisfied = true;
+				break;
+			}
+
+			const auto now = std::chrono::steady_clock::now();
+			if (now >= deadline) break;
+
+			// Sleep until something happens, but never past the deadline
+			const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+			if (wait_for_change(std::max(std::min(backoff, remaining), min_backoff)))
+			{
+				// More changes usually follow the first one
+				++report.notifications;
+				backoff = min_backoff;
+			}
+			else backoff = std::min(backoff * 2, max_backoff);
+		}
+
+		report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		m_last_wait_report = report;
+
+		return report;
+	}
+
+	QuietRestore::QuietRestore(DesktopBackend& backend) :
+		m_backend(backend)
+	{
+		m_backend.begin_quiet_restore();
+	}
+
+	QuietRestore::~QuietRestore()
+	{
+		try
+		{ m_backend.end_quiet_restore(); }
+		catch (...)
+		{}
+	}
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+/**
+ * @file desktop_backend.hpp
+ * @brief Desktop backend header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * File system information about a file or folder.
+	 */
+	struct FileInfo
+	{
+		/** Identifier unique within the filesystem (inode or file index). */
+		uint64_t id = 0;
+
+		/** Size in bytes. */
+		uint64_t size = 0;
+
+		/** Last modification time in nanoseconds since the Unix epoch. */
+		int64_t modified = 0;
+
+		/** If this is a folder. */
+		bool directory = false;
+	};
+
+	/** Most icons positioned in a single call to the desktop view. */
+	constexpr size_t icon_batch_size = 256;
+
+	/**
+	 * Where to put an item from the last enumeration.
+	 */
+	struct IconPlacement
+	{
+		/** Index of the item returned by get_icons(). */
+		size_t item = 0;
+
+		/** New location. */
+		IconPoint point = {};
+	};
+
+	/**
+	 * How much work the desktop view was asked to do.
+	 */
+	struct ViewStats
+	{
+		/** Number of forced refreshes. */
+		size_t refreshes = 0;
+
+		/** Number of times the view was repainted. */
+		size_t repaints = 0;
+	};
+
+	/**
+	 * Data copied because files were moved between filesystems.
+	 */
+	struct CopyStats
+	{
+		/** Number of files and folders copied. */
+		size_t files = 0;
+
+		/** Number of bytes copied. */
+		uint64_t bytes = 0;
+	};
+
+	/**
+	 * How the files of a cloned desktop were duplicated.
+	 */
+	struct CloneStats
+	{
+		/** Files sharing their data with the original until either is changed (copy on write). */
+		size_t reflinked = 0;
+
+		/** Files hard linked to the original, so changes made in place show up in both. */
+		size_t linked = 0;
+
+		/** Files copied in full. */
+		size_t copied = 0;
+
+		/** Bytes copied in full. */
+		uint64_t copied_bytes = 0;
+	};
+
+	/**
+	 * Result of waiting for the desktop view to catch up.
+	 */
+	struct WaitReport
+	{
+		/** If the view reached the desired state before the deadline. */
+		bool satisfied = false;
+
+		/** Number of items shown when the wait ended. */
+		size_t item_count = 0;
+
+		/** Number of times the item count was checked. */
+		size_t checks = 0;
+
+		/** Number of change notifications received. */
+		size_t notifications = 0;
+
+		/** Time taken in seconds. */
+		double seconds = 0.0;
+	};
+
+	/**
+	 * Platform layer used to inspect the desktop and move files around.
+	 * @note Items returned by get_icons() are remembered by index until the next full enumeration.
+	 */
+	class DesktopBackend
+	{
+	public:
+
+		/**
+		 * Destructor.
+		 */
+		virtual ~DesktopBackend() = default;
+
+		/**
+		 * Get the desktop path.
+		 * @return Desktop path.
+		 */
+		virtual std::string get_desktop_path() = 0;
+
+		/**
+		 * Get the number of items shown on the desktop.
+		 * @return Number of items.
+		 */
+		virtual size_t get_item_count() = 0;
+
+		/**
+		 * Wait until the number of items shown on the desktop satisfies a condition.
+		 * Sleeps on change notifications from the view, backing off when none arrive.
+		 * @param Condition on the item count.
+		 * @param How long to wait before giving up.
+		 * @return Wait report.
+		 */
+		WaitReport wait_for_items(const std::function<bool(size_t)>& done, std::chrono::milliseconds timeout);
+
+		/**
+		 * Get the report of the most recent wait.
+		 * @return Wait report, all zero if nothing waited yet.
+		 * @note Only the last one is kept, since a long lived backend waits many times.
+		 */
+		inline const WaitReport& get_last_wait_report() const noexcept;
+
+		/**
+		 * Enumerate every item shown on the desktop.
+		 * @return Desktop icons.
+		 */
+		virtual std::vector<DesktopIcon> get_icons() = 0;
+
+		/**
+		 * Enumerate only the items shown since the last enumeration, keeping the ones it returned.
+		 * @return Desktop icons that are new. Their indices carry on from the items enumerated before.
+		 * @note Only valid while items are being added, as they are while a desktop loads.
+		 */
+		virtual std::vector<DesktopIcon> get_new_icons() = 0;
+
+		/**
+		 * Move an item from the last enumeration.
+		 * @param Index of the item returned by get_icons().
+		 * @param New location.
+		 */
+		virtual void set_icon_position(size_t item, const IconPoint& point) = 0;
+
+		/**
+		 * Move many items from the last enumeration.
+		 * @param Placements.
+		 * @note Items are sent to the view icon_batch_size at a time.
+		 */
+		virtual void set_icon_positions(const std::vector<IconPlacement>& placements) = 0;
+
+		/**
+		 * Enable or disable auto arrange and snapping to the grid.
+		 * @param If icons should be aligned to the grid.
+		 */
+		virtual void set_grid_alignment(bool enabled) = 0;
+
+		/**
+		 * Force the desktop to update.
+		 * @note Doesn't repaint during a quiet restore.
+		 */
+		void refresh();
+
+		/**
+		 * Stop the view from repainting until the matching end_quiet_restore().
+		 * @note Calls can be nested.
+		 */
+		void begin_quiet_restore();
+
+		/**
+		 * Let the view repaint again, repainting once when the outermost quiet restore ends.
+		 */
+		void end_quiet_restore();
+
+		/**
+		 * Get how much work the view was asked to do so far.
+		 * @return View statistics.
+		 */
+		inline const ViewStats& get_view_stats() const noexcept;
+
+		/**
+		 * Get how much data moves had to copy so far.
+		 * @return Copy statistics.
+		 */
+		inline CopyStats get_copy_stats() const noexcept;
+
+		/**
+		 * Get a list of files in a folder.
+		 * @param Folder path.
+		 * @return File names, excluding "." and "..".
+		 */
+		virtual std::vector<std::string> list_files(const std::string& path) = 0;
+
+		/**
+		 * Move a file or folder.
+		 * @param Source path.
+		 * @param Destination path.
+		 * @return If the file was moved. False if the destination exists.
+		 * @note Called from several threads at once by the move engine.
+		 * @note Not durable until the folders involved are synced.
+		 * @note Moves to another filesystem copy the data and only remove the source once the copy is verified.
+		 */
+		virtual bool move_file(const std::string& from, const std::string& to) = 0;
+
+		/**
+		 * Duplicate a file or folder as cheaply as the filesystem allows.
+		 * Files are reflinked where the filesystem supports it, hard linked if not, and copied as a last resort.
+		 * @param Source path. Followed if it is a link.
+		 * @param Destination path, which must not exist.
+		 * @param Clone statistics to add to.
+		 * @return If everything was cloned. Nothing is left at the destination on failure.
+		 * @note Durable once the destination's parent folder is synced.
+		 */
+		virtual bool clone_file(const std::string& from, const std::string& to, CloneStats& stats) = 0;
+
+		/**
+		 * Remove a file, link or folder and everything in it. Links aren't followed.
+		 * @param Path.
+		 * @return If nothing is left at the path.
+		 */
+		virtual bool remove_tree(const std::string& path) = 0;
+
+		/**
+		 * Atomically replace a file, or an empty folder, with another one.
+		 * @param New file.
+		 * @param File to replace.
+		 * @return If the file was replaced.
+		 */
+		virtual bool replace_file(const std::string& from, const std::string& to) = 0;
+
+		/**
+		 * Flush the contents of a file to disk.
+		 * @param File path.
+		 * @return If the file was flushed.
+		 */
+		virtual bool sync_file(const std::string& path) = 0;
+
+		/**
+		 * Flush the entries of a folder to disk, making earlier renames in it durable.
+		 * @param Folder path.
+		 * @return If the folder was flushed.
+		 */
+		virtual bool sync_directory(const std::string& path) = 0;
+
+		/**
+		 * Swap two folders in one step.
+		 * @param First folder.
+		 * @param Second folder.
+		 * @return If the folders were swapped. Nothing is touched on failure.
+		 */
+		virtual bool exchange_directories(const std::string& a, const std::string& b) = 0;
+
+		/**
+		 * Check if the desktop folder can be swapped with exchange_directories() at all.
+		 * @return If exchanging the desktop folder can succeed. False once the filesystem turned an exchange down.
+		 */
+		virtual bool supports_exchange() const = 0;
+
+		/**
+		 * Check if two paths live on the same filesystem.
+		 * @param First path.
+		 * @param Second path.
+		 * @return If a rename between the two paths is a metadata only operation.
+		 */
+		virtual bool same_filesystem(const std::string& a, const std::string& b) = 0;
+
+		/**
+		 * Get information about a file or folder.
+		 * @param Path.
+		 * @param Information output.
+		 * @return If the path exists.
+		 */
+		virtual bool get_file_info(const std::string& path, FileInfo& info) = 0;
+
+		/**
+		 * Check if a path is a symbolic link or junction.
+		 * @param Path.
+		 * @return If the path is a link.
+		 */
+		virtual bool is_link(const std::string& path) = 0;
+
+		/**
+		 * Point a link at a folder, replacing an existing link or empty folder.
+		 * @param Link path.
+		 * @param Target folder.
+		 * @return If the link points at the target.
+		 */
+		virtual bool set_link(const std::string& link, const std::string& target) = 0;
+
+		/**
+		 * Remove a link without touching what it points at.
+		 * @param Link path.
+		 * @return If the link was removed.
+		 */
+		virtual bool remove_link(const std::string& link) = 0;
+
+		/**
+		 * Create a folder if it doesn't exist.
+		 * @param Folder path.
+		 * @return If the folder exists afterwards.
+		 */
+		virtual bool create_directory(const std::string& path) = 0;
+
+		/**
+		 * Check if a file or folder exists.
+		 * @param Path.
+		 * @return If the path exists.
+		 */
+		virtual bool file_exists(const std::string& path) = 0;
+
+	protected:
+
+		/**
+		 * Make the view re-read the desktop folder.
+		 */
+		virtual void refresh_view() = 0;
+
+		/**
+		 * Stop or resume repainting the view.
+		 * @param If the view should repaint. Resuming repaints the whole view once.
+		 */
+		virtual void set_view_redraw(bool enabled) = 0;
+
+		/**
+		 * Block until the desktop view might have changed.
+		 * @param Longest time to block.
+		 * @return If a change notification arrived.
+		 */
+		virtual bool wait_for_change(std::chrono::milliseconds timeout) = 0;
+
+		/**
+		 * Count a move that had to copy its data.
+		 * @param Number of bytes copied.
+		 * @note Safe to call from several threads at once.
+		 */
+		inline void record_copy(uint64_t bytes) noexcept;
+
+	private:
+
+		/** Report of the most recent wait. */
+		WaitReport m_last_wait_report = {};
+
+		/** Work the view was asked to do. */
+		ViewStats m_view_stats = {};
+
+		/** Number of quiet restores in progress. */
+		size_t m_quiet_depth = 0;
+
+		/** Number of moves that copied their data. Updated by the move engine workers. */
+		std::atomic<size_t> m_copied_files = { 0 };
+
+		/** Number of bytes those moves copied. */
+		std::atomic<uint64_t> m_copied_bytes = { 0 };
+	};
+
+	/**
+	 * Keeps the desktop view from repainting while it is alive.
+	 */
+	class QuietRestore
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Desktop backend.
+		 */
+		explicit QuietRestore(DesktopBackend& backend);
+
+		/**
+		 * Destructor.
+		 */
+		~QuietRestore();
+
+		QuietRestore(const QuietRestore&) = delete;
+		QuietRestore& operator=(const QuietRestore&) = delete;
+
+	private:
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+	};
+
+	/**
+	 * Create the backend for the host platform.
+	 * @return Desktop backend.
+	 */
+	extern std::unique_ptr<DesktopBackend> create_desktop_backend();
+}
+
+#include "desktop_backend.imp.hpp"
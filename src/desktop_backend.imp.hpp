@@ -0,0 +1,34 @@
+#pragma once
+
+/**
+ * @file desktop_backend.imp.hpp
+ * @brief Desktop backend header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline const WaitReport& DesktopBackend::get_last_wait_report() const noexcept
+	{
+		return m_last_wait_report;
+	}
+
+	inline const ViewStats& DesktopBackend::get_view_stats() const noexcept
+	{
+		return m_view_stats;
+	}
+
+	inline CopyStats DesktopBackend::get_copy_stats() const noexcept
+	{
+		CopyStats stats = {};
+		stats.files = m_copied_files.load(std::memory_order_relaxed);
+		stats.bytes = m_copied_bytes.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	inline void DesktopBackend::record_copy(uint64_t bytes) noexcept
+	{
+		m_copied_files.fetch_add(1, std::memory_order_relaxed);
+		m_copied_bytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+}
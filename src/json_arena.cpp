@@ -0,0 +1,51 @@
+/**
+ * @file json_arena.cpp
+ * @brief Arena allocated JSON documents source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <cassert>
+#include "json_arena.hpp"
+
+namespace ds
+{
+	thread_local JsonArena* JsonArena::s_current = nullptr;
+
+	JsonArena::JsonArena(size_t block_size) :
+		m_next_block_size(std::max<size_t>(block_size, 256)),
+		m_previous(s_current)
+	{
+		s_current = this;
+	}
+
+	JsonArena::~JsonArena()
+	{
+		// A document still using the arena would be left pointing at freed blocks
+		assert(m_live_count == 0 && "arena_json documents must be destroyed before their arena");
+		s_current = m_previous;
+	}
+
+	void* JsonArena::allocate_block(size_t size, size_t alignment)
+	{
+		// Big allocations get a block of their own so the current one keeps its space
+		const size_t needed = size + alignment;
+		Block block = {};
+		block.size = std::max(m_next_block_size, needed);
+		block.data.reset(new char[block.size]);
+
+		char* start = block.data.get();
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(start) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+
+		if (needed <= m_next_block_size)
+		{
+			m_pos = reinterpret_cast<char*>(aligned + size);
+			m_end = start + block.size;
+			m_next_block_size *= 2;
+		}
+
+		m_blocks.push_back(std::move(block));
+		return reinterpret_cast<void*>(aligned);
+	}
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+/**
+ * @file json_arena.hpp
+ * @brief Arena allocated JSON documents header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+namespace ds
+{
+	/**
+	 * Bump pointer arena that arena_json documents built on this thread allocate from while it is alive.
+	 * Nothing is freed until the arena is destroyed, which releases everything at once.
+	 * @note Documents must be destroyed before the arena they were built in, so declare the arena first.
+	 * Debug builds check this when the arena is destroyed.
+	 */
+	class JsonArena
+	{
+	public:
+
+		/**
+		 * Constructor. Makes this the arena of the calling thread until it is destroyed.
+		 * @param Size of the first block in bytes. Later blocks double in size.
+		 */
+		explicit JsonArena(size_t block_size = 16 * 1024);
+
+		/**
+		 * Destructor. Releases every block and restores the arena that was active before.
+		 */
+		~JsonArena();
+
+		JsonArena(const JsonArena&) = delete;
+		JsonArena& operator=(const JsonArena&) = delete;
+
+		/**
+		 * Allocate memory.
+		 * @param Size in bytes.
+		 * @param Alignment in bytes.
+		 * @return Memory, valid until the arena is destroyed.
+		 */
+		inline void* allocate(size_t size, size_t alignment);
+
+		/**
+		 * Note that a document gave back memory from this arena. The memory itself is kept until the arena is destroyed.
+		 */
+		inline void release() noexcept;
+
+		/**
+		 * Get the number of allocations served.
+		 * @return Allocation count.
+		 */
+		inline size_t get_allocation_count() const noexcept;
+
+		/**
+		 * Get the number of blocks taken from the heap.
+		 * @return Block count.
+		 */
+		inline size_t get_block_count() const noexcept;
+
+		/**
+		 * Get the number of bytes handed out.
+		 * @return Bytes used.
+		 */
+		inline size_t get_bytes_used() const noexcept;
+
+		/**
+		 * Get the arena of the calling thread.
+		 * @return Arena, or nullptr if there is none.
+		 */
+		inline static JsonArena* current() noexcept;
+
+	private:
+
+		/**
+		 * Allocate from a new block.
+		 * @param Size in bytes.
+		 * @param Alignment in bytes.
+		 * @return Memory.
+		 */
+		void* allocate_block(size_t size, size_t alignment);
+
+		/**
+		 * A chunk of memory taken from the heap.
+		 */
+		struct Block
+		{
+			/** Memory. */
+			std::unique_ptr<char[]> data = nullptr;
+
+			/** Size in bytes. */
+			size_t size = 0;
+		};
+
+		/** Blocks, newest last. */
+		std::vector<Block> m_blocks = {};
+
+		/** Next free byte in the newest block. */
+		char* m_pos = nullptr;
+
+		/** End of the newest block. */
+		char* m_end = nullptr;
+
+		/** Size of the next block. */
+		size_t m_next_block_size;
+
+		/** Allocations served. */
+		size_t m_allocation_count = 0;
+
+		/** Bytes handed out. */
+		size_t m_bytes_used = 0;
+
+		/** Allocations not given back yet. */
+		size_t m_live_count = 0;
+
+		/** Arena that was active before this one. */
+		JsonArena* const m_previous;
+
+		/** Arena of each thread. */
+		static thread_local JsonArena* s_current;
+	};
+
+	/**
+	 * Allocator for arena_json. Uses the arena of the calling thread, or the heap if there is none.
+	 * Every allocation starts with a header naming the arena it came from, so it is freed correctly whichever
+	 * arena is current by then.
+	 * @tparam Type to allocate.
+	 * @note nlohmann::json default constructs its allocators for every call, so an allocator can't hold the arena.
+	 */
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+
+		using value_type = T;
+
+		ArenaAllocator() = default;
+
+		/**
+		 * Converting constructor.
+		 * @param Allocator for another type.
+		 */
+		template<typename U>
+		inline ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+		/**
+		 * Allocate memory.
+		 * @param Number of objects.
+		 * @return Memory.
+		 */
+		inline T* allocate(size_t count);
+
+		/**
+		 * Free memory. Arena memory is left for the arena that handed it out to release.
+		 * @param Memory.
+		 * @param Number of objects.
+		 */
+		inline void deallocate(T* ptr, size_t count) noexcept;
+
+		/**
+		 * Construct an object.
+		 * @param Memory.
+		 * @param Constructor arguments.
+		 */
+		template<typename U, typename... Args>
+		inline void construct(U* ptr, Args&&... args);
+
+		/**
+		 * Destroy an object.
+		 * @param Object.
+		 */
+		template<typename U>
+		inline void destroy(U* ptr);
+
+	private:
+
+		/** Size of the header, which keeps the object after it aligned. */
+		static constexpr size_t header_size = alignof(T) > sizeof(JsonArena*) ? alignof(T) : sizeof(JsonArena*);
+	};
+
+	template<typename T, typename U>
+	inline bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept;
+
+	template<typename T, typename U>
+	inline bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept;
+
+	/**
+	 * JSON document whose nodes come from the arena of the calling thread.
+	 * @note Strings too long for the small string buffer still come from the heap.
+	 */
+	using arena_json = nlohmann::basic_json<std::map, std::vector, std::string, bool, int64_t, uint64_t, double, ArenaAllocator>;
+}
+
+#include "json_arena.imp.hpp"
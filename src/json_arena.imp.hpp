@@ -0,0 +1,106 @@
+#pragma once
+
+/**
+ * @file json_arena.imp.hpp
+ * @brief Arena allocated JSON documents header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <new>
+#include <utility>
+
+namespace ds
+{
+	inline void* JsonArena::allocate(size_t size, size_t alignment)
+	{
+		++m_allocation_count;
+		++m_live_count;
+		m_bytes_used += size;
+
+		// Round up within the current block
+		const uintptr_t pos = reinterpret_cast<uintptr_t>(m_pos);
+		const uintptr_t aligned = (pos + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		if (m_pos != nullptr && aligned + size <= reinterpret_cast<uintptr_t>(m_end))
+		{
+			m_pos = reinterpret_cast<char*>(aligned + size);
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		return allocate_block(size, alignment);
+	}
+
+	inline size_t JsonArena::get_allocation_count() const noexcept
+	{
+		return m_allocation_count;
+	}
+
+	inline size_t JsonArena::get_block_count() const noexcept
+	{
+		return m_blocks.size();
+	}
+
+	inline size_t JsonArena::get_bytes_used() const noexcept
+	{
+		return m_bytes_used;
+	}
+
+	inline void JsonArena::release() noexcept
+	{
+		--m_live_count;
+	}
+
+	inline JsonArena* JsonArena::current() noexcept
+	{
+		return s_current;
+	}
+
+	template<typename T>
+	inline T* ArenaAllocator<T>::allocate(size_t count)
+	{
+		const size_t size = header_size + count * sizeof(T);
+		JsonArena* arena = JsonArena::current();
+		void* memory = arena != nullptr ? arena->allocate(size, header_size) : ::operator new(size);
+
+		*static_cast<JsonArena**>(memory) = arena;
+		return reinterpret_cast<T*>(static_cast<char*>(memory) + header_size);
+	}
+
+	template<typename T>
+	inline void ArenaAllocator<T>::deallocate(T* ptr, size_t) noexcept
+	{
+		// Whichever arena is current now, the header knows where the memory came from
+		char* memory = reinterpret_cast<char*>(ptr) - header_size;
+		JsonArena* arena = *reinterpret_cast<JsonArena**>(memory);
+		if (arena == nullptr)
+			::operator delete(memory);
+		else
+			arena->release();
+	}
+
+	template<typename T>
+	template<typename U, typename... Args>
+	inline void ArenaAllocator<T>::construct(U* ptr, Args&&... args)
+	{
+		::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+	}
+
+	template<typename T>
+	template<typename U>
+	inline void ArenaAllocator<T>::destroy(U* ptr)
+	{
+		ptr->~U();
+	}
+
+	template<typename T, typename U>
+	inline bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept
+	{
+		return true;
+	}
+
+	template<typename T, typename U>
+	inline bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept
+	{
+		return false;
+	}
+}
@@ -0,0 +1,333 @@
+/**
+ * @file json_reader.cpp
+ * @brief Pull JSON reader source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstdlib>
+#include "json_reader.hpp"
+
+namespace
+{
+	/**
+	 * Read four hex digits.
+	 * @param First digit.
+	 * @param Code unit.
+	 * @return If the digits were valid.
+	 */
+	bool read_hex(const char* pos, uint32_t& unit)
+	{
+		unit = 0;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const char c = pos[i];
+			unit <<= 4;
+			if (c >= '0' && c <= '9') unit |= static_cast<uint32_t>(c - '0');
+			else if (c >= 'a' && c <= 'f') unit |= static_cast<uint32_t>(c - 'a' + 10);
+			else if (c >= 'A' && c <= 'F') unit |= static_cast<uint32_t>(c - 'A' + 10);
+			else return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Append a code point as UTF-8.
+	 * @param Output.
+	 * @param Code point.
+	 */
+	void append_utf8(std::string& out, uint32_t code)
+	{
+		if (code < 0x80)
+			out += static_cast<char>(code);
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+}
+
+namespace ds
+{
+	JsonReader::JsonReader(const char* data, size_t size) :
+		m_pos(data),
+		m_end(data + size)
+	{
+
+	}
+
+	JsonEvent JsonReader::next()
+	{
+		if (m_failed) return JsonEvent::Error;
+
+		// Whitespace
+		while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+			++m_pos;
+
+		if (m_pos == m_end)
+			return m_stack.empty() && m_need_comma ? JsonEvent::End : fail();
+
+		const char c = *m_pos;
+
+		// Values are separated by commas
+		if (m_need_comma && c != '}' && c != ']')
+		{
+			if (c != ',' || m_stack.empty()) return fail();
+			++m_pos;
+			m_need_comma = false;
+			return next();
+		}
+
+		switch (c)
+		{
+		case '{':
+		case '[':
+			if (m_need_comma || (!m_stack.empty() && m_stack.back() == '{' && m_expect_key)) return fail();
+			++m_pos;
+			m_stack.push_back(c);
+			m_expect_key = c == '{';
+			return c == '{' ? JsonEvent::BeginObject : JsonEvent::BeginArray;
+
+		case '}':
+		case ']':
+		{
+			// Trailing commas aren't allowed, but empty containers are
+			const char open = c == '}' ? '{' : '[';
+			if (m_stack.empty() || m_stack.back() != open) return fail();
+			if (!m_need_comma)
+			{
+				const char* prev = m_pos - 1;
+				while (*prev == ' ' || *prev == '\n' || *prev == '\r' || *prev == '\t') --prev;
+				if (*prev != open) return fail();
+			}
+			++m_pos;
+			m_stack.pop_back();
+			return value(c == '}' ? JsonEvent::EndObject : JsonEvent::EndArray);
+		}
+
+		case '"':
+			++m_pos;
+			if (!read_string()) return fail();
+
+			// Keys are followed by a colon
+			if (!m_stack.empty() && m_stack.back() == '{' && m_expect_key)
+			{
+				while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+					++m_pos;
+				if (m_pos == m_end || *m_pos != ':') return fail();
+				++m_pos;
+				m_expect_key = false;
+				return JsonEvent::Key;
+			}
+			return value(JsonEvent::String);
+
+		case 't':
+			if (!read_literal("true")) return fail();
+			m_bool = true;
+			return value(JsonEvent::Bool);
+
+		case 'f':
+			if (!read_literal("false")) return fail();
+			m_bool = false;
+			return value(JsonEvent::Bool);
+
+		case 'n':
+			if (!read_literal("null")) return fail();
+			return value(JsonEvent::Null);
+
+		default:
+			if (!read_number()) return fail();
+			return value(JsonEvent::Number);
+		}
+	}
+
+	bool JsonReader::skip(JsonEvent first)
+	{
+		if (first != JsonEvent::BeginObject && first != JsonEvent::BeginArray)
+			return first != JsonEvent::Error && first != JsonEvent::End;
+
+		// Skip until the matching end
+		size_t depth = 1;
+		while (depth > 0)
+		{
+			const JsonEvent event = next();
+			if (event == JsonEvent::BeginObject || event == JsonEvent::BeginArray) ++depth;
+			else if (event == JsonEvent::EndObject || event == JsonEvent::EndArray) --depth;
+			else if (event == JsonEvent::Error || event == JsonEvent::End) return false;
+		}
+
+		return true;
+	}
+
+	JsonEvent JsonReader::value(JsonEvent event)
+	{
+		// Values can't stand where a key should be
+		if (!m_stack.empty() && m_stack.back() == '{' && m_expect_key && event != JsonEvent::EndObject)
+			return fail();
+
+		m_need_comma = true;
+		m_expect_key = !m_stack.empty() && m_stack.back() == '{';
+		return event;
+	}
+
+	JsonEvent JsonReader::fail()
+	{
+		m_failed = true;
+		return JsonEvent::Error;
+	}
+
+	bool JsonReader::read_string()
+	{
+		// Most strings have no escapes and can be used where they are
+		const char* start = m_pos;
+		while (m_pos != m_end && *m_pos != '"' && *m_pos != '\\')
+		{
+			if (static_cast<unsigned char>(*m_pos) < 0x20) return false;
+			++m_pos;
+		}
+
+		if (m_pos == m_end) return false;
+		if (*m_pos == '"')
+		{
+			m_string.data = start;
+			m_string.size = static_cast<size_t>(m_pos - start);
+			++m_pos;
+			return true;
+		}
+
+		// Decode the rest into the scratch buffer
+		m_scratch.assign(start, m_pos);
+		while (m_pos != m_end && *m_pos != '"')
+		{
+			const char c = *m_pos++;
+			if (static_cast<unsigned char>(c) < 0x20) return false;
+			if (c != '\\')
+			{
+				m_scratch += c;
+				continue;
+			}
+
+			if (m_pos == m_end) return false;
+			switch (*m_pos++)
+			{
+			case '"': m_scratch += '"'; break;
+			case '\\': m_scratch += '\\'; break;
+			case '/': m_scratch += '/'; break;
+			case 'b': m_scratch += '\b'; break;
+			case 'f': m_scratch += '\f'; break;
+			case 'n': m_scratch += '\n'; break;
+			case 'r': m_scratch += '\r'; break;
+			case 't': m_scratch += '\t'; break;
+			case 'u':
+			{
+				uint32_t code = 0;
+				if (m_end - m_pos < 4 || !read_hex(m_pos, code)) return false;
+				m_pos += 4;
+
+				// Surrogate pairs
+				if (code >= 0xD800 && code <= 0xDBFF)
+				{
+					uint32_t low = 0;
+					if (m_end - m_pos < 6 || m_pos[0] != '\\' || m_pos[1] != 'u' || !read_hex(m_pos + 2, low)) return false;
+					if (low < 0xDC00 || low > 0xDFFF) return false;
+					m_pos += 6;
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else if (code >= 0xDC00 && code <= 0xDFFF) return false;
+
+				append_utf8(m_scratch, code);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+
+		if (m_pos == m_end) return false;
+		++m_pos;
+
+		m_string.data = m_scratch.data();
+		m_string.size = m_scratch.size();
+		return true;
+	}
+
+	bool JsonReader::read_number()
+	{
+		const char* start = m_pos;
+		bool integral = true;
+
+		if (m_pos != m_end && *m_pos == '-') ++m_pos;
+
+		// Integer part, without leading zeros
+		if (m_pos == m_end || *m_pos < '0' || *m_pos > '9') return false;
+		if (*m_pos == '0') ++m_pos;
+		else while (m_pos != m_end && *m_pos >= '0' && *m_pos <= '9') ++m_pos;
+
+		// Fraction
+		if (m_pos != m_end && *m_pos == '.')
+		{
+			integral = false;
+			++m_pos;
+			if (m_pos == m_end || *m_pos < '0' || *m_pos > '9') return false;
+			while (m_pos != m_end && *m_pos >= '0' && *m_pos <= '9') ++m_pos;
+		}
+
+		// Exponent
+		if (m_pos != m_end && (*m_pos == 'e' || *m_pos == 'E'))
+		{
+			integral = false;
+			++m_pos;
+			if (m_pos != m_end && (*m_pos == '+' || *m_pos == '-')) ++m_pos;
+			if (m_pos == m_end || *m_pos < '0' || *m_pos > '9') return false;
+			while (m_pos != m_end && *m_pos >= '0' && *m_pos <= '9') ++m_pos;
+		}
+
+		if (integral)
+		{
+			// Plain integers are by far the most common, so skip strtod for them
+			const bool negative = *start == '-';
+			uint64_t magnitude = 0;
+			for (const char* p = start + (negative ? 1 : 0); p != m_pos; ++p)
+				magnitude = magnitude * 10 + static_cast<uint64_t>(*p - '0');
+
+			m_int = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+			m_number = static_cast<double>(m_int);
+			return true;
+		}
+
+		// strtod needs a terminated copy
+		char text[64] = {};
+		const size_t size = static_cast<size_t>(m_pos - start);
+		if (size >= sizeof(text)) return false;
+		std::memcpy(text, start, size);
+
+		m_number = std::strtod(text, nullptr);
+		m_int = static_cast<int64_t>(m_number);
+		return true;
+	}
+
+	bool JsonReader::read_literal(const char* literal)
+	{
+		const size_t size = std::strlen(literal);
+		if (static_cast<size_t>(m_end - m_pos) < size || std::memcmp(m_pos, literal, size) != 0)
+			return false;
+
+		m_pos += size;
+		return true;
+	}
+}
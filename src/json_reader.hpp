@@ -0,0 +1,164 @@
+#pragma once
+
+/**
+ * @file json_reader.hpp
+ * @brief Pull JSON reader header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * Things the reader can run into.
+	 */
+	enum class JsonEvent
+	{
+		BeginObject = 0,
+		EndObject = 1,
+		BeginArray = 2,
+		EndArray = 3,
+		Key = 4,
+		String = 5,
+		Number = 6,
+		Bool = 7,
+		Null = 8,
+		End = 9,
+		Error = 10
+	};
+
+	/**
+	 * Reads JSON text one event at a time, without building a document.
+	 * Strings without escapes point straight into the text; escaped ones are decoded into a buffer
+	 * that is reused, so reading allocates nothing per value.
+	 */
+	class JsonReader
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param JSON text.
+		 * @param Size of the text in bytes.
+		 * @note The text must outlive the reader.
+		 */
+		JsonReader(const char* data, size_t size);
+
+		/**
+		 * Read the next event.
+		 * @return Event. Error and End repeat forever.
+		 */
+		JsonEvent next();
+
+		/**
+		 * Skip the rest of a value.
+		 * @param Event that started the value.
+		 * @return If the value was skipped without errors.
+		 */
+		bool skip(JsonEvent first);
+
+		/**
+		 * Get the last key or string.
+		 * @return String, valid until the next event.
+		 */
+		inline NameRef get_string() const noexcept;
+
+		/**
+		 * Check if the last key or string is equal to a string.
+		 * @param String.
+		 * @return If they are equal.
+		 */
+		inline bool string_equals(const char* str) const noexcept;
+
+		/**
+		 * Get the last number as an integer.
+		 * @return Number, truncated towards zero.
+		 */
+		inline int64_t get_int() const noexcept;
+
+		/**
+		 * Get the last number.
+		 * @return Number.
+		 */
+		inline double get_number() const noexcept;
+
+		/**
+		 * Get the last boolean.
+		 * @return Boolean.
+		 */
+		inline bool get_bool() const noexcept;
+
+	private:
+
+		/**
+		 * Finish a value, expecting a comma before the next one.
+		 * @param Event for the value.
+		 * @return The event.
+		 */
+		JsonEvent value(JsonEvent event);
+
+		/**
+		 * Stop reading.
+		 * @return Error.
+		 */
+		JsonEvent fail();
+
+		/**
+		 * Read a string after its opening quote.
+		 * @return If the string was valid.
+		 */
+		bool read_string();
+
+		/**
+		 * Read a number.
+		 * @return If the number was valid.
+		 */
+		bool read_number();
+
+		/**
+		 * Read a literal (true, false, null).
+		 * @param Literal.
+		 * @return If the literal was there.
+		 */
+		bool read_literal(const char* literal);
+
+		/** Current position. */
+		const char* m_pos = nullptr;
+
+		/** End of the text. */
+		const char* m_end = nullptr;
+
+		/** Open containers, '{' or '['. */
+		std::vector<char> m_stack = {};
+
+		/** If a comma or closing bracket has to come next. */
+		bool m_need_comma = false;
+
+		/** If the next string in an object is a key. */
+		bool m_expect_key = false;
+
+		/** If reading stopped. */
+		bool m_failed = false;
+
+		/** Last key or string. */
+		NameRef m_string = {};
+
+		/** Decoded strings with escapes. */
+		std::string m_scratch = {};
+
+		/** Last number. */
+		double m_number = 0.0;
+
+		/** Last number as an integer. */
+		int64_t m_int = 0;
+
+		/** Last boolean. */
+		bool m_bool = false;
+	};
+}
+
+#include "json_reader.imp.hpp"
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * @file json_reader.imp.hpp
+ * @brief Pull JSON reader header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline NameRef JsonReader::get_string() const noexcept
+	{
+		return m_string;
+	}
+
+	inline bool JsonReader::string_equals(const char* str) const noexcept
+	{
+		const size_t size = std::strlen(str);
+		return size == m_string.size && (size == 0 || std::memcmp(m_string.data, str, size) == 0);
+	}
+
+	inline int64_t JsonReader::get_int() const noexcept
+	{
+		return m_int;
+	}
+
+	inline double JsonReader::get_number() const noexcept
+	{
+		return m_number;
+	}
+
+	inline bool JsonReader::get_bool() const noexcept
+	{
+		return m_bool;
+	}
+}
@@ -0,0 +1,229 @@
+/**
+ * @file layout_file.cpp
+ * @brief Binary layout file source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <stdexcept>
+#include "layout_file.hpp"
+#include "layout_json.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/** Identifies a layout file. */
+	constexpr char layout_magic[4] = { 'D', 'S', 'L', '1' };
+
+	/** Version of the layout format. */
+	constexpr uint32_t layout_version = 1;
+
+	/**
+	 * Append a field.
+	 * @param Contents.
+	 * @param Field.
+	 */
+	void write_field(std::string& out, uint32_t field)
+	{
+		char bytes[sizeof(field)];
+		std::memcpy(bytes, &field, sizeof(field));
+		out.append(bytes, sizeof(bytes));
+	}
+}
+
+namespace ds
+{
+	LayoutFile::~LayoutFile()
+	{
+		release();
+	}
+
+	LayoutFile::LayoutFile(LayoutFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	LayoutFile& LayoutFile::operator=(LayoutFile&& other) noexcept
+	{
+		if (this == &other) return *this;
+
+		release();
+		m_size = other.m_size;
+		m_icon_count = other.m_icon_count;
+		m_mapped = other.m_mapped;
+		m_buffer = std::move(other.m_buffer);
+
+		// Short buffers live inside the string, so they move with it
+		m_data = m_mapped ? other.m_data : m_buffer.data();
+
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_icon_count = 0;
+		other.m_mapped = false;
+		other.m_buffer.clear();
+
+		return *this;
+	}
+
+	LayoutFile LayoutFile::map(const std::string& path)
+	{
+		LayoutFile layout = {};
+
+#if defined(_WIN32)
+		HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Unable to open the layout file.");
+
+		LARGE_INTEGER size = {};
+		HANDLE mapping = NULL;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		// The view keeps the file open by itself
+		CloseHandle(file);
+		if (mapping == NULL) throw std::runtime_error("Unable to map the layout file.");
+
+		const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (data == nullptr) throw std::runtime_error("Unable to map the layout file.");
+
+		layout.m_size = static_cast<size_t>(size.QuadPart);
+#else
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("Unable to open the layout file.");
+
+		struct stat st = {};
+		void* data = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+			data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		// The mapping keeps the file open by itself
+		close(fd);
+		if (data == MAP_FAILED) throw std::runtime_error("Unable to map the layout file.");
+
+		layout.m_size = static_cast<size_t>(st.st_size);
+#endif
+
+		layout.m_data = static_cast<const char*>(data);
+		layout.m_mapped = true;
+		layout.validate();
+
+		return layout;
+	}
+
+	LayoutFile LayoutFile::from_buffer(std::string buffer)
+	{
+		LayoutFile layout = {};
+		layout.m_buffer = std::move(buffer);
+		layout.m_data = layout.m_buffer.data();
+		layout.m_size = layout.m_buffer.size();
+		layout.validate();
+
+		return layout;
+	}
+
+	std::string LayoutFile::encode(const std::vector<DesktopIcon>& icons)
+	{
+		size_t string_size = 0;
+		for (const auto& icon : icons)
+			string_size += icon.name.size();
+
+		std::string out = {};
+		out.reserve(header_size + icons.size() * record_size + string_size);
+
+		// Header
+		out.append(layout_magic, sizeof(layout_magic));
+		write_field(out, layout_version);
+		write_field(out, static_cast<uint32_t>(icons.size()));
+		write_field(out, static_cast<uint32_t>(string_size));
+
+		// Records
+		uint32_t offset = 0;
+		for (const auto& icon : icons)
+		{
+			write_field(out, offset);
+			write_field(out, static_cast<uint32_t>(icon.name.size()));
+			write_field(out, static_cast<uint32_t>(icon.point.x));
+			write_field(out, static_cast<uint32_t>(icon.point.y));
+			offset += static_cast<uint32_t>(icon.name.size());
+		}
+
+		// String table
+		for (const auto& icon : icons)
+			out += icon.name;
+
+		return out;
+	}
+
+	std::string LayoutFile::from_json(const std::string& text)
+	{
+		std::vector<DesktopIcon> icons = {};
+		if (!read_locations_json(text.data(), text.size(), icons))
+			throw std::runtime_error("Damaged locations file");
+
+		return encode(icons);
+	}
+
+	std::string LayoutFile::to_json() const
+	{
+		std::vector<DesktopIcon> icons(m_icon_count);
+		for (size_t i = 0; i < m_icon_count; ++i)
+		{
+			const NameRef name = get_name(i);
+			icons[i].name.assign(name.data, name.size);
+			icons[i].point = get_point(i);
+		}
+
+		return write_locations_json(icons);
+	}
+
+	void LayoutFile::validate()
+	{
+		if (m_size < header_size || std::memcmp(m_data, layout_magic, sizeof(layout_magic)) != 0)
+			throw std::runtime_error("Not a layout file.");
+
+		if (read_field(4) != layout_version)
+			throw std::runtime_error("Unsupported layout file version.");
+
+		// Every byte has to be accounted for
+		const uint64_t icon_count = read_field(8);
+		const uint64_t string_size = read_field(12);
+		if (header_size + icon_count * record_size + string_size != m_size)
+			throw std::runtime_error("Layout file has the wrong size.");
+
+		m_icon_count = static_cast<size_t>(icon_count);
+
+		// Names must stay inside the string table
+		for (size_t i = 0; i < m_icon_count; ++i)
+		{
+			const size_t record = header_size + i * record_size;
+			if (static_cast<uint64_t>(read_field(record)) + read_field(record + 4) > string_size)
+				throw std::runtime_error("Layout file has a name out of bounds.");
+		}
+	}
+
+	void LayoutFile::release() noexcept
+	{
+		if (m_mapped && m_data != nullptr)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(m_data);
+#else
+			munmap(const_cast<char*>(m_data), m_size);
+#endif
+		}
+
+		m_data = nullptr;
+		m_size = 0;
+		m_icon_count = 0;
+		m_mapped = false;
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+/**
+ * @file layout_file.hpp
+ * @brief Binary layout file header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * Read-only view of a binary layout (locations.bin).
+	 *
+	 * The file is a 16 byte header ("DSL1", version, icon count, string table size), one 16 byte record
+	 * per icon (name offset, name size, x, y) and a string table holding every name back to back. Every
+	 * field is a 32 bit integer in host byte order (little endian on every supported platform).
+	 * Files are memory mapped, so reading a layout needs no parsing and no allocation per icon.
+	 */
+	class LayoutFile
+	{
+	public:
+
+		LayoutFile() = default;
+
+		/**
+		 * Destructor.
+		 * @note Unmaps the file.
+		 */
+		~LayoutFile();
+
+		LayoutFile(LayoutFile&& other) noexcept;
+		LayoutFile& operator=(LayoutFile&& other) noexcept;
+
+		LayoutFile(const LayoutFile&) = delete;
+		LayoutFile& operator=(const LayoutFile&) = delete;
+
+		/**
+		 * Map a layout file.
+		 * @param File path.
+		 * @return Layout.
+		 * @note Throws if the file can't be mapped or isn't a valid layout.
+		 */
+		static LayoutFile map(const std::string& path);
+
+		/**
+		 * Use a layout held in memory.
+		 * @param Contents of a layout file.
+		 * @return Layout.
+		 * @note Throws if the contents aren't a valid layout.
+		 */
+		static LayoutFile from_buffer(std::string buffer);
+
+		/**
+		 * Serialize icon positions.
+		 * @param Desktop icons.
+		 * @return Contents of a layout file.
+		 */
+		static std::string encode(const std::vector<DesktopIcon>& icons);
+
+		/**
+		 * Convert a locations file to a binary layout.
+		 * @param Contents of a locations file.
+		 * @return Contents of a layout file.
+		 */
+		static std::string from_json(const std::string& text);
+
+		/**
+		 * Convert the layout to a locations file.
+		 * @return Contents of a locations file.
+		 */
+		std::string to_json() const;
+
+		/**
+		 * Get the number of icons.
+		 * @return Number of icons.
+		 */
+		inline size_t get_icon_count() const noexcept;
+
+		/**
+		 * Get the name of an icon.
+		 * @param Icon index.
+		 * @return Name, valid for as long as the layout is.
+		 */
+		inline NameRef get_name(size_t i) const noexcept;
+
+		/**
+		 * Get the location of an icon.
+		 * @param Icon index.
+		 * @return Location.
+		 */
+		inline IconPoint get_point(size_t i) const noexcept;
+
+	private:
+
+		/** Size of the header in bytes. */
+		static constexpr size_t header_size = 16;
+
+		/** Size of an icon record in bytes. */
+		static constexpr size_t record_size = 16;
+
+		/**
+		 * Check the contents and read the header.
+		 * @note Throws if the contents aren't a valid layout.
+		 */
+		void validate();
+
+		/**
+		 * Read a field.
+		 * @param Byte offset.
+		 * @return Field.
+		 */
+		inline uint32_t read_field(size_t offset) const noexcept;
+
+		/**
+		 * Unmap or free the contents.
+		 */
+		void release() noexcept;
+
+		/** Contents. */
+		const char* m_data = nullptr;
+
+		/** Size of the contents in bytes. */
+		size_t m_size = 0;
+
+		/** Number of icons. */
+		size_t m_icon_count = 0;
+
+		/** If the contents are a mapped file. */
+		bool m_mapped = false;
+
+		/** Contents held in memory, if not mapped. */
+		std::string m_buffer = "";
+	};
+}
+
+#include "layout_file.imp.hpp"
@@ -0,0 +1,43 @@
+#pragma once
+
+/**
+ * @file layout_file.imp.hpp
+ * @brief Binary layout file header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline size_t LayoutFile::get_icon_count() const noexcept
+	{
+		return m_icon_count;
+	}
+
+	inline NameRef LayoutFile::get_name(size_t i) const noexcept
+	{
+		const size_t record = header_size + i * record_size;
+		const size_t strings = header_size + m_icon_count * record_size;
+
+		NameRef name = {};
+		name.data = m_data + strings + read_field(record);
+		name.size = read_field(record + 4);
+		return name;
+	}
+
+	inline IconPoint LayoutFile::get_point(size_t i) const noexcept
+	{
+		const size_t record = header_size + i * record_size;
+
+		IconPoint point = {};
+		point.x = static_cast<int32_t>(read_field(record + 8));
+		point.y = static_cast<int32_t>(read_field(record + 12));
+		return point;
+	}
+
+	inline uint32_t LayoutFile::read_field(size_t offset) const noexcept
+	{
+		uint32_t field = 0;
+		std::memcpy(&field, m_data + offset, sizeof(field));
+		return field;
+	}
+}
@@ -0,0 +1,97 @@
+/**
+ * @file layout_index.cpp
+ * @brief Layout index source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include "layout_index.hpp"
+
+namespace
+{
+	/** Marks an empty slot or the end of a chain of icons. */
+	constexpr size_t no_icon = static_cast<size_t>(-1);
+}
+
+namespace ds
+{
+	LayoutIndex::LayoutIndex(const std::vector<DesktopIcon>& icons) :
+		m_names(icons.size()),
+		m_points(icons.size())
+	{
+		for (size_t i = 0; i < icons.size(); ++i)
+		{
+			m_names[i].data = icons[i].name.data();
+			m_names[i].size = icons[i].name.size();
+			m_points[i] = icons[i].point;
+		}
+
+		build();
+	}
+
+	LayoutIndex::LayoutIndex(const LayoutFile& layout) :
+		m_names(layout.get_icon_count()),
+		m_points(layout.get_icon_count())
+	{
+		for (size_t i = 0; i < layout.get_icon_count(); ++i)
+		{
+			m_names[i] = layout.get_name(i);
+			m_points[i] = layout.get_point(i);
+		}
+
+		build();
+	}
+
+	bool LayoutIndex::take(const std::string& name, IconPoint& point)
+	{
+		NameRef ref = {};
+		ref.data = name.data();
+		ref.size = name.size();
+
+		const size_t slot = find_slot(ref);
+		if (m_slots[slot] == no_icon || m_heads[slot] == no_icon)
+			return false;
+
+		// Hand out the icon and move on to the next one with that name
+		point = m_points[m_heads[slot]];
+		m_heads[slot] = m_next[m_heads[slot]];
+
+		return true;
+	}
+
+	void LayoutIndex::build()
+	{
+		// Keep the table at most half full
+		size_t slot_count = 1;
+		while (slot_count < m_names.size() * 2)
+			slot_count *= 2;
+
+		m_next.assign(m_names.size(), no_icon);
+		m_slots.assign(slot_count, no_icon);
+		m_heads.assign(slot_count, no_icon);
+
+		// Walk backwards so each chain ends up in save order
+		for (size_t i = m_names.size(); i-- > 0; )
+		{
+			const size_t slot = find_slot(m_names[i]);
+			if (m_slots[slot] == no_icon)
+				m_slots[slot] = i;
+			else
+				m_next[i] = m_heads[slot];
+
+			m_heads[slot] = i;
+		}
+	}
+
+	size_t LayoutIndex::find_slot(const NameRef& name) const noexcept
+	{
+		const size_t mask = m_slots.size() - 1;
+		size_t slot = static_cast<size_t>(hash_name(name)) & mask;
+
+		// Linear probing
+		while (m_slots[slot] != no_icon && !(m_names[m_slots[slot]] == name))
+			slot = (slot + 1) & mask;
+
+		return slot;
+	}
+}
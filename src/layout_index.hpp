@@ -0,0 +1,76 @@
+#pragma once
+
+/**
+ * @file layout_index.hpp
+ * @brief Layout index header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "layout_file.hpp"
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * Looks up saved icon positions by name.
+	 * Icons sharing a name are handed out in the order they were saved, so restoring a layout with
+	 * duplicate display names always gives the same result.
+	 * @note Names aren't copied, so the icons or layout the index was built from must outlive it.
+	 */
+	class LayoutIndex
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Saved icons.
+		 */
+		explicit LayoutIndex(const std::vector<DesktopIcon>& icons);
+
+		/**
+		 * Constructor.
+		 * @param Saved layout.
+		 */
+		explicit LayoutIndex(const LayoutFile& layout);
+
+		/**
+		 * Take the position of the next saved icon with a name.
+		 * @param Icon name.
+		 * @param Position of the icon.
+		 * @return If there was an icon left with that name.
+		 */
+		bool take(const std::string& name, IconPoint& point);
+
+	private:
+
+		/**
+		 * Build the hash table once the names and positions are in.
+		 */
+		void build();
+
+		/**
+		 * Find the slot of a name.
+		 * @param Name.
+		 * @return Slot holding the name, or the empty slot it would go in.
+		 */
+		size_t find_slot(const NameRef& name) const noexcept;
+
+		/** Saved names. */
+		std::vector<NameRef> m_names = {};
+
+		/** Saved positions. */
+		std::vector<IconPoint> m_points = {};
+
+		/** Index of the next saved icon with the same name, for every saved icon. */
+		std::vector<size_t> m_next = {};
+
+		/** Index of an icon with the slot's name, or empty. Open addressing, a power of two in size. */
+		std::vector<size_t> m_slots = {};
+
+		/** Index of the first icon left with the slot's name. */
+		std::vector<size_t> m_heads = {};
+	};
+}
@@ -0,0 +1,176 @@
+/**
+ * @file layout_json.cpp
+ * @brief Locations file serialization source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include "json_reader.hpp"
+#include "layout_json.hpp"
+
+namespace
+{
+	/**
+	 * Append an integer.
+	 * @param JSON text.
+	 * @param Integer.
+	 */
+	void append_int(std::string& out, int32_t value)
+	{
+		char digits[12];
+		size_t pos = sizeof(digits);
+
+		// Work in 64 bits so the smallest value can be negated
+		int64_t v = value;
+		const bool negative = v < 0;
+		if (negative) v = -v;
+
+		do
+		{
+			digits[--pos] = static_cast<char>('0' + v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		if (negative) digits[--pos] = '-';
+
+		out.append(digits + pos, sizeof(digits) - pos);
+	}
+
+	/**
+	 * Read an icon object.
+	 * @param Reader, just past the start of the object.
+	 * @param Icon to fill.
+	 * @return If the object was valid.
+	 */
+	bool read_icon(ds::JsonReader& reader, ds::DesktopIcon& icon)
+	{
+		bool has_name = false;
+		bool has_location = false;
+
+		for (ds::JsonEvent event = reader.next(); event != ds::JsonEvent::EndObject; event = reader.next())
+		{
+			if (event != ds::JsonEvent::Key) return false;
+
+			if (reader.string_equals("name"))
+			{
+				if (reader.next() != ds::JsonEvent::String) return false;
+				const ds::NameRef name = reader.get_string();
+				icon.name.assign(name.data, name.size);
+				has_name = true;
+			}
+			else if (reader.string_equals("location"))
+			{
+				if (reader.next() != ds::JsonEvent::BeginArray) return false;
+				if (reader.next() != ds::JsonEvent::Number) return false;
+				icon.point.x = static_cast<int32_t>(reader.get_int());
+				if (reader.next() != ds::JsonEvent::Number) return false;
+				icon.point.y = static_cast<int32_t>(reader.get_int());
+				if (reader.next() != ds::JsonEvent::EndArray) return false;
+				has_location = true;
+			}
+			else if (!reader.skip(reader.next()))
+				return false;
+		}
+
+		return has_name && has_location;
+	}
+}
+
+namespace ds
+{
+	void append_json_string(std::string& out, const std::string& str)
+	{
+		static const char hex[] = "0123456789abcdef";
+
+		out += '"';
+		for (const char c : str)
+		{
+			switch (c)
+			{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				// Other control characters as \u00XX, everything else (UTF-8 included) as is
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					out += "\\u00";
+					out += hex[c >> 4];
+					out += hex[c & 0xF];
+				}
+				else out += c;
+				break;
+			}
+		}
+		out += '"';
+	}
+
+	std::string write_locations_json(const std::vector<DesktopIcon>& icons)
+	{
+		if (icons.empty())
+			return "{\n    \"icons\": []\n}";
+
+		// Roughly the size of the fixed text around every icon
+		size_t size = 32;
+		for (const auto& icon : icons)
+			size += icon.name.size() + 160;
+
+		std::string out = {};
+		out.reserve(size);
+
+		// Keys are sorted, so "location" comes before "name"
+		out += "{\n    \"icons\": [\n";
+		for (size_t i = 0; i < icons.size(); ++i)
+		{
+			if (i != 0) out += ",\n";
+
+			out += "        {\n            \"location\": [\n                ";
+			append_int(out, icons[i].point.x);
+			out += ",\n                ";
+			append_int(out, icons[i].point.y);
+			out += "\n            ],\n            \"name\": ";
+			append_json_string(out, icons[i].name);
+			out += "\n        }";
+		}
+		out += "\n    ]\n}";
+
+		return out;
+	}
+
+	bool read_locations_json(const char* data, size_t size, std::vector<DesktopIcon>& icons)
+	{
+		JsonReader reader(data, size);
+
+		// Older versions saved an empty desktop as null
+		const JsonEvent first = reader.next();
+		if (first == JsonEvent::Null) return reader.next() == JsonEvent::End;
+		if (first != JsonEvent::BeginObject) return false;
+
+		for (JsonEvent event = reader.next(); event != JsonEvent::EndObject; event = reader.next())
+		{
+			if (event != JsonEvent::Key) return false;
+
+			if (!reader.string_equals("icons"))
+			{
+				if (!reader.skip(reader.next())) return false;
+				continue;
+			}
+
+			event = reader.next();
+			if (event == JsonEvent::Null) continue;
+			if (event != JsonEvent::BeginArray) return false;
+			for (event = reader.next(); event != JsonEvent::EndArray; event = reader.next())
+			{
+				if (event != JsonEvent::BeginObject) return false;
+				icons.emplace_back();
+				if (!read_icon(reader, icons.back())) return false;
+			}
+		}
+
+		return reader.next() == JsonEvent::End;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+ * @file layout_json.hpp
+ * @brief Locations file serialization header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * Append a string to JSON text as a quoted, escaped JSON string.
+	 * @param JSON text.
+	 * @param String.
+	 * @note Escapes exactly what nlohmann::json does.
+	 */
+	extern void append_json_string(std::string& out, const std::string& str);
+
+	/**
+	 * Write a locations file straight from the icons, without building a JSON document.
+	 * @param Desktop icons.
+	 * @return Contents of the locations file, byte for byte what json::dump(4) produces.
+	 * @note Except for a desktop without icons, which gives an empty icons array where older versions wrote null.
+	 */
+	extern std::string write_locations_json(const std::vector<DesktopIcon>& icons);
+
+	/**
+	 * Read a locations file straight into icons, without building a JSON document.
+	 * @param Contents of a locations file.
+	 * @param Size of the contents in bytes.
+	 * @param Icons to fill.
+	 * @return If the file was valid.
+	 * @note Unknown keys are skipped. A null document or missing icons, which older versions wrote for
+	 * a desktop without icons, read as no icons.
+	 */
+	extern bool read_locations_json(const char* data, size_t size, std::vector<DesktopIcon>& icons);
+}
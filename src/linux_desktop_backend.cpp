@@ -0,0 +1,612 @@
+/**
+ * @file linux_desktop_backend.cpp
+ * @brief Linux desktop backend source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "linux_desktop_backend.hpp"
+#include "linux_file_copy.hpp"
+#include "json_arena.hpp"
+#include "trace.hpp"
+
+/** POSIX */
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Not exposed by older C libraries. */
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+namespace
+{
+	/**
+	 * Get an environment variable.
+	 * @param Variable name.
+	 * @return Value, or an empty string if it isn't set.
+	 */
+	std::string get_env(const char* name)
+	{
+		const char* value = std::getenv(name);
+		return value == nullptr ? std::string() : std::string(value);
+	}
+
+	/**
+	 * Read the desktop folder from a user-dirs.dirs file.
+	 * @param Path to the file.
+	 * @param Home folder.
+	 * @return Desktop path, or an empty string if none is set.
+	 */
+	std::string read_user_dirs(const std::string& path, const std::string& home)
+	{
+		std::ifstream stream(path);
+		const std::string key = "XDG_DESKTOP_DIR=";
+
+		for (std::string line; std::getline(stream, line); )
+		{
+			if (line.compare(0, key.size(), key) != 0)
+				continue;
+
+			// Strip the key and quotes
+			std::string value = line.substr(key.size());
+			if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+				value = value.substr(1, value.size() - 2);
+
+			// Expand $HOME
+			if (value.compare(0, 5, "$HOME") == 0)
+				value = home + value.substr(5);
+
+			return value;
+		}
+
+		return "";
+	}
+
+	/**
+	 * Rename a file or folder, failing if the destination exists.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @return If the file was renamed. errno is EEXIST if the destination exists.
+	 */
+	bool rename_no_replace(const std::string& from, const std::string& to)
+	{
+#if defined(SYS_renameat2)
+		if (syscall(SYS_renameat2, AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0)
+			return true;
+
+		// Only fall back if the kernel or filesystem doesn't support it
+		if (errno != ENOSYS && errno != EINVAL)
+			return false;
+#endif
+
+		// Not atomic, but nothing else should be moving files into the saves
+		struct stat existing = {};
+		if (lstat(to.c_str(), &existing) == 0)
+		{
+			errno = EEXIST;
+			return false;
+		}
+
+		return std::rename(from.c_str(), to.c_str()) == 0;
+	}
+}
+
+namespace ds
+{
+	std::string find_xdg_desktop_path()
+	{
+		// Explicit override
+		std::string desktop = get_env("XDG_DESKTOP_DIR");
+		if (!desktop.empty()) return desktop;
+
+		const std::string home = get_env("HOME");
+		if (home.empty()) throw std::runtime_error("Unable to locate the home folder");
+
+		// Ask the user dirs file
+		std::string config = get_env("XDG_CONFIG_HOME");
+		if (config.empty()) config = join_path(home, ".config");
+
+		desktop = read_user_dirs(join_path(config, "user-dirs.dirs"), home);
+		if (!desktop.empty()) return desktop;
+
+		return join_path(home, "Desktop");
+	}
+
+	std::unique_ptr<DesktopBackend> create_desktop_backend()
+	{
+		// Let the simulated view lag behind like a real shell does
+		const std::string delay = get_env("DS_VIEW_DELAY_MS");
+
+		return std::make_unique<LinuxDesktopBackend>
+		(
+			find_xdg_desktop_path(),
+			join_path(get_desktop_saver_path(), "positions.json"),
+			std::chrono::milliseconds(delay.empty() ? 0 : std::strtol(delay.c_str(), nullptr, 10))
+		);
+	}
+
+	LinuxDesktopBackend::LinuxDesktopBackend(const std::string& desktop_path, const std::string& positions_path, std::chrono::milliseconds view_delay) :
+		m_desktop_path(desktop_path),
+		m_positions_path(positions_path),
+		m_view_delay(view_delay)
+	{
+		// Make sure the desktop exists
+		if (!create_directory(m_desktop_path))
+			throw std::runtime_error("Unable to create the Desktop folder");
+	}
+
+	LinuxDesktopBackend::~LinuxDesktopBackend()
+	{
+		try
+		{ write_positions(); }
+		catch (...)
+		{}
+
+		if (m_notify_fd >= 0)
+			close(m_notify_fd);
+	}
+
+	std::string LinuxDesktopBackend::get_desktop_path()
+	{
+		return m_desktop_path;
+	}
+
+	size_t LinuxDesktopBackend::get_item_count()
+	{
+		// Pick up changes without blocking
+		read_notifications(std::chrono::milliseconds(0));
+
+		// Re-read the folder once the view would have noticed
+		if (m_view_stale && std::chrono::steady_clock::now() >= m_view_changed + m_view_delay)
+		{
+			m_view_count = list_files(m_desktop_path).size();
+			m_view_stale = false;
+		}
+
+		return m_view_count;
+	}
+
+	std::vector<DesktopIcon> LinuxDesktopBackend::get_icons()
+	{
+		DS_TRACE_SCOPE("LinuxDesktopBackend::get_icons");
+
+		read_positions();
+
+		// Every file is an icon
+		watch_desktop();
+		m_items = list_files(m_desktop_path);
+		std::sort(m_items.begin(), m_items.end());
+		m_item_names = std::unordered_set<std::string>(m_items.begin(), m_items.end());
+
+		// The view is up to date after a full enumeration
+		m_view_count = m_items.size();
+		m_view_stale = false;
+
+		std::vector<DesktopIcon> icons(m_items.size());
+		for (size_t i = 0; i < m_items.size(); ++i)
+		{
+			icons[i].name = m_items[i];
+
+			const auto position = m_positions.find(m_items[i]);
+			if (position != m_positions.end())
+				icons[i].point = position->second;
+		}
+
+		return icons;
+	}
+
+	std::vector<DesktopIcon> LinuxDesktopBackend::get_new_icons()
+	{
+		DS_TRACE_SCOPE("LinuxDesktopBackend::get_new_icons");
+
+		read_positions();
+
+		// Files that weren't there last time, in the order a full enumeration would list them
+		watch_desktop();
+		const auto files = list_files(m_desktop_path);
+		std::vector<std::string> names = {};
+		for (const auto& file : files)
+			if (m_item_names.insert(file).second)
+				names.push_back(file);
+		std::sort(names.begin(), names.end());
+
+		// The view is up to date after an enumeration
+		m_view_count = files.size();
+		m_view_stale = false;
+
+		std::vector<DesktopIcon> icons(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			icons[i].name = names[i];
+
+			const auto position = m_positions.find(names[i]);
+			if (position != m_positions.end())
+				icons[i].point = position->second;
+		}
+
+		m_items.insert(m_items.end(), names.begin(), names.end());
+		return icons;
+	}
+
+	void LinuxDesktopBackend::set_icon_position(size_t item, const IconPoint& point)
+	{
+		read_positions();
+		m_positions[m_items.at(item)] = point;
+		m_positions_dirty = true;
+		++m_position_calls;
+	}
+
+	void LinuxDesktopBackend::set_icon_positions(const std::vector<IconPlacement>& placements)
+	{
+		DS_TRACE_SCOPE("LinuxDesktopBackend::set_icon_positions");
+
+		read_positions();
+		for (const auto& placement : placements)
+			m_positions[m_items.at(placement.item)] = placement.point;
+
+		m_positions_dirty |= !placements.empty();
+		m_position_calls += (placements.size() + icon_batch_size - 1) / icon_batch_size;
+	}
+
+	void LinuxDesktopBackend::set_grid_alignment(bool enabled)
+	{
+		// Plain folders have no grid
+		(void)enabled;
+	}
+
+	void LinuxDesktopBackend::refresh_view()
+	{
+		mark_view_stale();
+		read_positions();
+
+		// Forget the positions of files that left the desktop
+		const auto files = list_files(m_desktop_path);
+		const std::unordered_map<std::string, IconPoint> old_positions = std::move(m_positions);
+		m_positions.clear();
+
+		for (const auto& file : files)
+		{
+			const auto position = old_positions.find(file);
+			if (position != old_positions.end())
+				m_positions.insert(*position);
+		}
+
+		if (m_positions.size() != old_positions.size())
+			m_positions_dirty = true;
+
+		// Repainting is what saves the positions
+		if (m_redraw)
+			write_positions();
+	}
+
+	void LinuxDesktopBackend::set_view_redraw(bool enabled)
+	{
+		m_redraw = enabled;
+		if (m_redraw)
+			write_positions();
+	}
+
+	std::vector<std::string> LinuxDesktopBackend::list_files(const std::string& path)
+	{
+		// List of files
+		std::vector<std::string> files = {};
+
+		DIR* dir = opendir(path.c_str());
+		if (dir == nullptr) return files;
+
+		while (const dirent* entry = readdir(dir))
+		{
+			// We don't care about these files
+			if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+				continue;
+
+			// Add the files name
+			files.push_back(entry->d_name);
+		}
+
+		closedir(dir);
+
+		return files;
+	}
+
+	bool LinuxDesktopBackend::move_file(const std::string& from, const std::string& to)
+	{
+		// Like MoveFileEx, never replace what is already there
+		if (rename_no_replace(from, to))
+			return true;
+
+		// The saves live on another filesystem, so the data has to be copied
+		if (errno != EXDEV)
+			return false;
+
+		uint64_t bytes = 0;
+		if (!move_across_filesystems(from, to, bytes))
+			return false;
+
+		record_copy(bytes);
+		return true;
+	}
+
+	bool LinuxDesktopBackend::clone_file(const std::string& from, const std::string& to, CloneStats& stats)
+	{
+		return clone_tree(from, to, stats);
+	}
+
+	bool LinuxDesktopBackend::remove_tree(const std::string& path)
+	{
+		return ds::remove_tree(path) || !file_exists(path);
+	}
+
+	bool LinuxDesktopBackend::replace_file(const std::string& from, const std::string& to)
+	{
+		return std::rename(from.c_str(), to.c_str()) == 0;
+	}
+
+	bool LinuxDesktopBackend::sync_file(const std::string& path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return false;
+
+		const bool synced = fdatasync(fd) == 0;
+		close(fd);
+		return synced;
+	}
+
+	bool LinuxDesktopBackend::sync_directory(const std::string& path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0) return false;
+
+		const bool synced = fsync(fd) == 0;
+		close(fd);
+		return synced;
+	}
+
+	bool LinuxDesktopBackend::exchange_directories(const std::string& a, const std::string& b)
+	{
+#if defined(SYS_renameat2)
+		// Atomic swap
+		if (syscall(SYS_renameat2, AT_FDCWD, a.c_str(), AT_FDCWD, b.c_str(), RENAME_EXCHANGE) == 0)
+			return true;
+
+		// A swap through a temporary name can't be recovered after a crash, so don't try one
+		if (errno == ENOSYS || errno == EINVAL)
+			m_exchange_unsupported = true;
+#else
+		m_exchange_unsupported = true;
+#endif
+
+		return false;
+	}
+
+	bool LinuxDesktopBackend::supports_exchange() const
+	{
+		return !m_exchange_unsupported;
+	}
+
+	bool LinuxDesktopBackend::same_filesystem(const std::string& a, const std::string& b)
+	{
+		struct stat info_a = {};
+		struct stat info_b = {};
+		if (stat(a.c_str(), &info_a) != 0 || stat(b.c_str(), &info_b) != 0)
+			return false;
+
+		return info_a.st_dev == info_b.st_dev;
+	}
+
+	bool LinuxDesktopBackend::get_file_info(const std::string& path, FileInfo& info)
+	{
+		struct stat file_stat = {};
+		if (lstat(path.c_str(), &file_stat) != 0)
+			return false;
+
+		info.id = static_cast<uint64_t>(file_stat.st_ino);
+		info.size = static_cast<uint64_t>(file_stat.st_size);
+		info.modified = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+		info.directory = S_ISDIR(file_stat.st_mode);
+		return true;
+	}
+
+	bool LinuxDesktopBackend::is_link(const std::string& path)
+	{
+		struct stat info = {};
+		return lstat(path.c_str(), &info) == 0 && S_ISLNK(info.st_mode);
+	}
+
+	bool LinuxDesktopBackend::set_link(const std::string& link, const std::string& target)
+	{
+		// A real folder has to go first, and only if it's empty
+		if (file_exists(link) && !is_link(link) && rmdir(link.c_str()) != 0)
+			return false;
+
+		// Build the new link on the side and rename it into place so the swap is atomic
+		const std::string temp = link + ".ds-link";
+		unlink(temp.c_str());
+		if (symlink(target.c_str(), temp.c_str()) != 0)
+			return false;
+
+		if (std::rename(temp.c_str(), link.c_str()) != 0)
+		{
+			unlink(temp.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	bool LinuxDesktopBackend::remove_link(const std::string& link)
+	{
+		return is_link(link) && unlink(link.c_str()) == 0;
+	}
+
+	bool LinuxDesktopBackend::create_directory(const std::string& path)
+	{
+		// Create every parent along the way
+		for (size_t i = 1; i <= path.size(); ++i)
+		{
+			if (i != path.size() && path[i] != path_separator)
+				continue;
+
+			const std::string parent = path.substr(0, i);
+			if (mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST)
+				return false;
+		}
+
+		struct stat info = {};
+		return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+	}
+
+	bool LinuxDesktopBackend::file_exists(const std::string& path)
+	{
+		struct stat info = {};
+		return lstat(path.c_str(), &info) == 0;
+	}
+
+	bool LinuxDesktopBackend::wait_for_change(std::chrono::milliseconds timeout)
+	{
+		// A change already seen shows up in the view once the delay passes
+		if (m_view_stale)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			const auto ready = m_view_changed + m_view_delay;
+			if (now < ready && ready <= now + timeout)
+			{
+				std::this_thread::sleep_until(ready);
+				read_notifications(std::chrono::milliseconds(0));
+				return true;
+			}
+		}
+
+		return read_notifications(timeout);
+	}
+
+	void LinuxDesktopBackend::watch_desktop()
+	{
+		if (m_notify_fd < 0)
+		{
+			m_notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (m_notify_fd < 0) return;
+		}
+
+		// Watches follow the folder, not the path, so check it is still the same one
+		const int watch = inotify_add_watch(m_notify_fd, m_desktop_path.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+		if (watch == m_notify_watch) return;
+
+		// The folder was swapped or linked, so the view has to start over
+		if (m_notify_watch >= 0)
+			inotify_rm_watch(m_notify_fd, m_notify_watch);
+
+		m_notify_watch = watch;
+		mark_view_stale();
+	}
+
+	bool LinuxDesktopBackend::read_notifications(std::chrono::milliseconds timeout)
+	{
+		watch_desktop();
+
+		// Without notifications the view is always out of date
+		if (m_notify_fd < 0 || m_notify_watch < 0)
+		{
+			m_view_stale = true;
+			std::this_thread::sleep_for(timeout);
+			return false;
+		}
+
+		pollfd fd = {};
+		fd.fd = m_notify_fd;
+		fd.events = POLLIN;
+		if (poll(&fd, 1, static_cast<int>(timeout.count())) <= 0)
+			return false;
+
+		// Drain every pending event
+		alignas(inotify_event) char buffer[4096];
+		bool changed = false;
+		while (read(m_notify_fd, buffer, sizeof(buffer)) > 0)
+			changed = true;
+
+		if (changed)
+			mark_view_stale();
+
+		return changed;
+	}
+
+	void LinuxDesktopBackend::mark_view_stale()
+	{
+		if (m_view_stale) return;
+
+		m_view_stale = true;
+		m_view_changed = std::chrono::steady_clock::now();
+	}
+
+	void LinuxDesktopBackend::read_positions()
+	{
+		if (m_positions_read) return;
+		m_positions_read = true;
+
+		std::ifstream stream(m_positions_path);
+		if (!stream) return;
+
+		// A damaged file only loses icon positions, so start over instead of failing every command
+		try
+		{
+			JsonArena arena;
+			arena_json positions = {};
+			positions << stream;
+
+			std::unordered_map<std::string, IconPoint> read = {};
+			for (const auto& icon : positions.at("icons"))
+			{
+				IconPoint p = {};
+				p.x = icon.at("location").at(0).get<int32_t>();
+				p.y = icon.at("location").at(1).get<int32_t>();
+				read[icon.at("name").get<std::string>()] = p;
+			}
+
+			m_positions = std::move(read);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "WARNING: Ignoring damaged icon positions in " << m_positions_path << ": " << e.what() << '\n';
+		}
+	}
+
+	void LinuxDesktopBackend::write_positions()
+	{
+		if (!m_positions_dirty) return;
+
+		JsonArena arena;
+		arena_json positions = {};
+		positions["icons"] = arena_json::array();
+		for (const auto& position : m_positions)
+		{
+			arena_json icon = {};
+			icon["name"] = position.first;
+			icon["location"] = { position.second.x, position.second.y };
+			positions["icons"].push_back(icon);
+		}
+
+		std::ofstream stream(m_positions_path);
+		stream << positions.dump(4);
+		m_positions_dirty = false;
+	}
+}
\ No newline at end of file
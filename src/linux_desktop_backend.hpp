@@ -0,0 +1,187 @@
+#pragma once
+
+/**
+ * @file linux_desktop_backend.hpp
+ * @brief Linux desktop backend header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <unordered_map>
+#include <unordered_set>
+#include "desktop_backend.hpp"
+
+namespace ds
+{
+	/**
+	 * Find the XDG desktop folder.
+	 * @return Desktop path.
+	 * @note Checks $XDG_DESKTOP_DIR, then user-dirs.dirs, then ~/Desktop.
+	 */
+	extern std::string find_xdg_desktop_path();
+
+	/**
+	 * Desktop backend managing a plain desktop folder.
+	 * Every file in the folder is an icon. Icon positions are kept in a sidecar JSON file since
+	 * the folder itself has nowhere to store them.
+	 * The item count comes from a simulated shell view that only re-reads the folder once inotify
+	 * reports a change, optionally after a delay, so waits behave like they do against a real shell.
+	 */
+	class LinuxDesktopBackend : public DesktopBackend
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Desktop path.
+		 * @param Path to the icon positions file.
+		 * @param How long the simulated view takes to notice a change.
+		 */
+		LinuxDesktopBackend(const std::string& desktop_path, const std::string& positions_path, std::chrono::milliseconds view_delay = std::chrono::milliseconds(0));
+
+		/**
+		 * Destructor.
+		 * @note Writes any pending icon positions.
+		 */
+		~LinuxDesktopBackend() override;
+
+		std::string get_desktop_path() override;
+
+		size_t get_item_count() override;
+
+		std::vector<DesktopIcon> get_icons() override;
+
+		std::vector<DesktopIcon> get_new_icons() override;
+
+		void set_icon_position(size_t item, const IconPoint& point) override;
+
+		void set_icon_positions(const std::vector<IconPlacement>& placements) override;
+
+		void set_grid_alignment(bool enabled) override;
+
+		std::vector<std::string> list_files(const std::string& path) override;
+
+		bool move_file(const std::string& from, const std::string& to) override;
+
+		bool clone_file(const std::string& from, const std::string& to, CloneStats& stats) override;
+
+		bool remove_tree(const std::string& path) override;
+
+		bool replace_file(const std::string& from, const std::string& to) override;
+
+		bool sync_file(const std::string& path) override;
+
+		bool sync_directory(const std::string& path) override;
+
+		bool exchange_directories(const std::string& a, const std::string& b) override;
+
+		bool supports_exchange() const override;
+
+		bool same_filesystem(const std::string& a, const std::string& b) override;
+
+		bool get_file_info(const std::string& path, FileInfo& info) override;
+
+		bool is_link(const std::string& path) override;
+
+		bool set_link(const std::string& link, const std::string& target) override;
+
+		bool remove_link(const std::string& link) override;
+
+		bool create_directory(const std::string& path) override;
+
+		bool file_exists(const std::string& path) override;
+
+		/**
+		 * Get the number of calls made to position icons, as a real view would see them.
+		 * @return Number of positioning calls.
+		 */
+		inline size_t get_position_call_count() const noexcept;
+
+	protected:
+
+		void refresh_view() override;
+
+		void set_view_redraw(bool enabled) override;
+
+		bool wait_for_change(std::chrono::milliseconds timeout) override;
+
+	private:
+
+		/**
+		 * Watch whatever folder is at the desktop path.
+		 */
+		void watch_desktop();
+
+		/**
+		 * Wait for change notifications and mark the view out of date if any arrive.
+		 * @param Longest time to block.
+		 * @return If a notification arrived.
+		 */
+		bool read_notifications(std::chrono::milliseconds timeout);
+
+		/**
+		 * Note that the view no longer matches the folder.
+		 */
+		void mark_view_stale();
+
+		/**
+		 * Read the positions file if it hasn't been read yet.
+		 */
+		void read_positions();
+
+		/**
+		 * Write the positions file if anything changed.
+		 */
+		void write_positions();
+
+		/** Desktop path. */
+		const std::string m_desktop_path;
+
+		/** Path to the icon positions file. */
+		const std::string m_positions_path;
+
+		/** Icon positions by file name. */
+		std::unordered_map<std::string, IconPoint> m_positions = {};
+
+		/** Items from the last enumeration. */
+		std::vector<std::string> m_items = {};
+
+		/** Names of the items from the last enumeration. */
+		std::unordered_set<std::string> m_item_names = {};
+
+		/** How long the simulated view takes to notice a change. */
+		const std::chrono::milliseconds m_view_delay;
+
+		/** Number of items in the simulated view. */
+		size_t m_view_count = 0;
+
+		/** If the simulated view is out of date. */
+		bool m_view_stale = true;
+
+		/** When the simulated view went out of date. */
+		std::chrono::steady_clock::time_point m_view_changed = {};
+
+		/** Inotify instance, or -1. */
+		int m_notify_fd = -1;
+
+		/** Watch on the desktop folder, or -1. */
+		int m_notify_watch = -1;
+
+		/** Number of calls made to position icons. */
+		size_t m_position_calls = 0;
+
+		/** If the simulated view is repainting. */
+		bool m_redraw = true;
+
+		/** If the positions file has been read. */
+		bool m_positions_read = false;
+
+		/** If the positions need to be written. */
+		bool m_positions_dirty = false;
+
+		/** If the kernel or filesystem turned down an atomic exchange. */
+		bool m_exchange_unsupported = false;
+	};
+}
+
+#include "linux_desktop_backend.imp.hpp"
@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * @file linux_desktop_backend.imp.hpp
+ * @brief Linux desktop backend header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline size_t LinuxDesktopBackend::get_position_call_count() const noexcept
+	{
+		return m_position_calls;
+	}
+}
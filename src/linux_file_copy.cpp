@@ -0,0 +1,565 @@
+/**
+ * @file linux_file_copy.cpp
+ * @brief Cross filesystem moves and clones on Linux source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "linux_file_copy.hpp"
+#include "util.hpp"
+#include "trace.hpp"
+
+/** POSIX */
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Not exposed by older kernel headers. */
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+namespace
+{
+	/** Largest buffer used to stream a file. */
+	constexpr size_t copy_buffer_size = 1 << 20;
+
+	/** Alignment of copy buffers. A page, so the kernel can copy to and from them whole. */
+	constexpr size_t copy_alignment = 4096;
+
+	/** Most bytes handed to the kernel in one offloaded copy. */
+	constexpr size_t offload_chunk_size = 64 << 20;
+
+	/**
+	 * Hash of a stream of bytes, the same no matter how the stream is split up.
+	 * @note Meant to catch corruption, not tampering.
+	 */
+	class StreamHash
+	{
+	public:
+
+		/**
+		 * Add bytes to the stream.
+		 * @param Data.
+		 * @param Number of bytes.
+		 */
+		void update(const char* data, size_t size) noexcept
+		{
+			m_size += size;
+
+			// Finish the word left over from the last chunk
+			if (m_tail_size != 0)
+			{
+				const size_t take = std::min(size, sizeof(m_tail) - m_tail_size);
+				std::memcpy(m_tail + m_tail_size, data, take);
+				m_tail_size += take;
+				data += take;
+				size -= take;
+
+				if (m_tail_size < sizeof(m_tail)) return;
+				mix(m_tail);
+				m_tail_size = 0;
+			}
+
+			for (; size >= sizeof(m_tail); data += sizeof(m_tail), size -= sizeof(m_tail))
+				mix(data);
+
+			std::memcpy(m_tail, data, size);
+			m_tail_size = size;
+		}
+
+		/**
+		 * Get the hash of the bytes so far.
+		 * @return Hash.
+		 */
+		uint64_t get() const noexcept
+		{
+			StreamHash hash = *this;
+
+			// Streams that only differ in trailing zeros still differ in size
+			char last[sizeof(m_tail)] = {};
+			std::memcpy(last, m_tail, m_tail_size);
+			hash.mix(last);
+			std::memcpy(last, &m_size, sizeof(m_size));
+			hash.mix(last);
+
+			return hash.m_state;
+		}
+
+	private:
+
+		/**
+		 * Mix a word into the state.
+		 * @param Word, which doesn't have to be aligned.
+		 * @note Every step is invertible, so a changed word always changes the hash.
+		 */
+		void mix(const char* data) noexcept
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, data, sizeof(word));
+			m_state = (m_state ^ word) * 0x9E3779B97F4A7C15ull;
+			m_state ^= m_state >> 32;
+		}
+
+		/** Hash state. */
+		uint64_t m_state = 14695981039346656037ull;
+
+		/** Number of bytes so far. */
+		uint64_t m_size = 0;
+
+		/** Bytes that don't make up a whole word yet. */
+		char m_tail[8] = {};
+
+		/** Number of bytes in the tail. */
+		size_t m_tail_size = 0;
+	};
+
+	/**
+	 * Frees a buffer from posix_memalign().
+	 */
+	struct FreeBuffer
+	{
+		void operator()(char* buffer) const noexcept
+		{
+			std::free(buffer);
+		}
+	};
+
+	/** Aligned copy buffer. */
+	using CopyBuffer = std::unique_ptr<char, FreeBuffer>;
+
+	/**
+	 * Allocate a copy buffer big enough for a file, up to the largest buffer.
+	 * @param File size.
+	 * @param Buffer size output.
+	 * @return Buffer, or nullptr if out of memory.
+	 */
+	CopyBuffer make_buffer(uint64_t file_size, size_t& size)
+	{
+		const uint64_t wanted = std::min<uint64_t>(std::max<uint64_t>(file_size, 1), copy_buffer_size);
+		size = static_cast<size_t>((wanted + copy_alignment - 1) / copy_alignment * copy_alignment);
+
+		void* buffer = nullptr;
+		if (posix_memalign(&buffer, copy_alignment, size) != 0)
+			return nullptr;
+
+		return CopyBuffer(static_cast<char*>(buffer));
+	}
+
+	/**
+	 * Write a whole buffer.
+	 * @param File descriptor.
+	 * @param Data.
+	 * @param Number of bytes.
+	 * @return If everything was written.
+	 */
+	bool write_all(int fd, const char* data, size_t size)
+	{
+		while (size != 0)
+		{
+			const ssize_t written = write(fd, data, size);
+			if (written < 0 && errno == EINTR) continue;
+			if (written <= 0) return false;
+
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Hash a file from the start.
+	 * @param File descriptor.
+	 * @param Buffer.
+	 * @param Buffer size.
+	 * @param Hash output.
+	 * @return If the whole file was read.
+	 */
+	bool hash_file(int fd, char* buffer, size_t buffer_size, StreamHash& hash)
+	{
+		off_t offset = 0;
+		for (;;)
+		{
+			const ssize_t count = pread(fd, buffer, buffer_size, offset);
+			if (count < 0 && errno == EINTR) continue;
+			if (count < 0) return false;
+			if (count == 0) return true;
+
+			hash.update(buffer, static_cast<size_t>(count));
+			offset += count;
+		}
+	}
+
+	/**
+	 * Copy the contents of a file, hashing them on the way.
+	 * @param Source file descriptor.
+	 * @param Destination file descriptor.
+	 * @param Buffer.
+	 * @param Buffer size.
+	 * @param Hash of the source output.
+	 * @param Number of bytes copied output.
+	 * @return If the whole file was copied.
+	 */
+	bool copy_contents(int in, int out, char* buffer, size_t buffer_size, StreamHash& hash, uint64_t& bytes)
+	{
+#if defined(SYS_copy_file_range)
+		// Let the kernel copy, which skips user space and can offload to the storage or a file server
+		loff_t in_offset = 0;
+		loff_t out_offset = 0;
+		for (;;)
+		{
+			const ssize_t count = syscall(SYS_copy_file_range, in, &in_offset, out, &out_offset, offload_chunk_size, 0u);
+			if (count < 0 && errno == EINTR) continue;
+			if (count == 0) break;
+
+			if (count < 0)
+			{
+				// Only fall back if the kernel or filesystems can't do it at all
+				if (in_offset != 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP))
+					return false;
+
+				break;
+			}
+		}
+
+		// The data never passed through here, so the source has to be read to hash it
+		if (in_offset != 0)
+		{
+			bytes = static_cast<uint64_t>(in_offset);
+			return hash_file(in, buffer, buffer_size, hash);
+		}
+#endif
+
+		// Stream the file through the buffer, hashing it as it goes
+		for (;;)
+		{
+			const ssize_t count = read(in, buffer, buffer_size);
+			if (count < 0 && errno == EINTR) continue;
+			if (count < 0) return false;
+			if (count == 0) return true;
+
+			hash.update(buffer, static_cast<size_t>(count));
+			if (!write_all(out, buffer, static_cast<size_t>(count)))
+				return false;
+
+			bytes += static_cast<uint64_t>(count);
+		}
+	}
+
+	/**
+	 * Copy a regular file and check the copy made it to disk intact.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @param Source information.
+	 * @param Number of bytes copied output.
+	 * @return If the file was copied.
+	 */
+	bool copy_file(const std::string& from, const std::string& to, const struct stat& info, uint64_t& bytes)
+	{
+		size_t buffer_size = 0;
+		const CopyBuffer buffer = make_buffer(static_cast<uint64_t>(info.st_size), buffer_size);
+		if (buffer == nullptr) return false;
+
+		const int in = open(from.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+		if (in < 0) return false;
+
+		const int out = open(to.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+		if (out < 0)
+		{
+			close(in);
+			return false;
+		}
+
+		posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		StreamHash source_hash = {};
+		uint64_t copied = 0;
+		const struct timespec times[2] = { info.st_atim, info.st_mtim };
+		bool intact = copy_contents(in, out, buffer.get(), buffer_size, source_hash, copied) &&
+			fchmod(out, info.st_mode & 07777) == 0 &&
+			futimens(out, times) == 0 &&
+			fsync(out) == 0;
+
+		close(in);
+
+		// Read the copy back from the disk rather than the page cache where possible
+		if (intact)
+		{
+			posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+
+			StreamHash copy_hash = {};
+			intact = hash_file(out, buffer.get(), buffer_size, copy_hash) && copy_hash.get() == source_hash.get();
+		}
+
+		close(out);
+
+		if (intact) bytes += copied;
+		return intact;
+	}
+
+	/**
+	 * Progress of cloning a tree.
+	 */
+	struct CloneContext
+	{
+		/** What ended up in the clone. */
+		ds::CloneStats stats = {};
+
+		/** If the filesystem might support reflinks. */
+		bool can_reflink = true;
+
+		/** If the filesystem might support hard links. */
+		bool can_link = true;
+	};
+
+	/**
+	 * Make a file that shares the data of another until either is changed.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @param Source information.
+	 * @param If the filesystem supports reflinks output. Left alone if it might.
+	 * @return If the filesystem could clone the file. Nothing is left at the destination if not.
+	 */
+	bool reflink_file(const std::string& from, const std::string& to, const struct stat& info, bool& supported)
+	{
+		const int in = open(from.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+		if (in < 0) return false;
+
+		const int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+		if (out < 0)
+		{
+			close(in);
+			return false;
+		}
+
+		// Only the extent metadata is written, so flushing it is cheap
+		const struct timespec times[2] = { info.st_atim, info.st_mtim };
+		const bool reflinked = ioctl(out, FICLONE, in) == 0;
+		if (!reflinked && (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL || errno == EXDEV))
+			supported = false;
+
+		const bool cloned = reflinked &&
+			fchmod(out, info.st_mode & 07777) == 0 &&
+			futimens(out, times) == 0 &&
+			fsync(out) == 0;
+
+		close(in);
+		close(out);
+
+		if (!cloned) unlink(to.c_str());
+		return cloned;
+	}
+
+	/**
+	 * Duplicate a regular file as cheaply as the filesystem allows.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @param Source information.
+	 * @param Clone progress.
+	 * @return If the file was duplicated.
+	 * @note Methods the filesystem doesn't support aren't tried again for the rest of the tree.
+	 */
+	bool clone_regular_file(const std::string& from, const std::string& to, const struct stat& info, CloneContext& context)
+	{
+		if (context.can_reflink && reflink_file(from, to, info, context.can_reflink))
+		{
+			++context.stats.reflinked;
+			return true;
+		}
+
+		// Hard links share the file itself, which is free but doesn't diverge on in place edits
+		if (context.can_link)
+		{
+			if (link(from.c_str(), to.c_str()) == 0)
+			{
+				++context.stats.linked;
+				return true;
+			}
+
+			if (errno == EXDEV || errno == EPERM || errno == EOPNOTSUPP)
+				context.can_link = false;
+		}
+
+		if (!copy_file(from, to, info, context.stats.copied_bytes))
+			return false;
+
+		++context.stats.copied;
+		return true;
+	}
+
+	/**
+	 * Copy a file, link or folder, preserving permissions and modification times.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @param Number of bytes copied output.
+	 * @param Clone progress if files should be cloned rather than copied, or nullptr.
+	 * @param If the source should be followed if it is a link.
+	 * @return If everything was copied. Partial copies are left behind.
+	 */
+	bool copy_entry(const std::string& from, const std::string& to, uint64_t& bytes, CloneContext* clone = nullptr, bool follow = false)
+	{
+		struct stat info = {};
+		if ((follow ? stat(from.c_str(), &info) : lstat(from.c_str(), &info)) != 0)
+			return false;
+
+		const struct timespec times[2] = { info.st_atim, info.st_mtim };
+
+		if (S_ISREG(info.st_mode))
+			return clone != nullptr ? clone_regular_file(from, to, info, *clone) : copy_file(from, to, info, bytes);
+
+		if (S_ISLNK(info.st_mode))
+		{
+			std::vector<char> target(static_cast<size_t>(info.st_size > 0 ? info.st_size : PATH_MAX) + 1);
+			const ssize_t size = readlink(from.c_str(), target.data(), target.size());
+			if (size < 0 || static_cast<size_t>(size) >= target.size())
+				return false;
+
+			target[static_cast<size_t>(size)] = '\0';
+			return symlink(target.data(), to.c_str()) == 0 &&
+				utimensat(AT_FDCWD, to.c_str(), times, AT_SYMLINK_NOFOLLOW) == 0;
+		}
+
+		// Devices, pipes and sockets have no business on a desktop
+		if (!S_ISDIR(info.st_mode))
+			return false;
+
+		if (mkdir(to.c_str(), S_IRWXU) != 0)
+			return false;
+
+		DIR* dir = opendir(from.c_str());
+		if (dir == nullptr) return false;
+
+		bool copied = true;
+		while (const dirent* entry = readdir(dir))
+		{
+			if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+				continue;
+
+			if (!copy_entry(ds::join_path(from, entry->d_name), ds::join_path(to, entry->d_name), bytes, clone))
+			{
+				copied = false;
+				break;
+			}
+		}
+
+		closedir(dir);
+		if (!copied) return false;
+
+		// Permissions last, in case they don't let us write into the folder
+		if (chmod(to.c_str(), info.st_mode & 07777) != 0 || utimensat(AT_FDCWD, to.c_str(), times, 0) != 0)
+			return false;
+
+		// The entries have to be durable before the source goes away
+		const int fd = open(to.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0) return false;
+
+		const bool synced = fsync(fd) == 0;
+		close(fd);
+		return synced;
+	}
+
+	/**
+	 * Remove one entry of a tree being walked.
+	 * @return 0 to keep walking.
+	 */
+	int remove_walked_entry(const char* path, const struct stat*, int, struct FTW*)
+	{
+		return std::remove(path) == 0 ? 0 : -1;
+	}
+
+	/**
+	 * Check one entry of a tree being walked for removal.
+	 * @return 0 to keep walking.
+	 */
+	int check_walked_entry(const char* path, const struct stat*, int type, struct FTW*)
+	{
+		// Entries are removed through their folder, so only folders need to be writable
+		if (type != FTW_D) return 0;
+		return access(path, W_OK | X_OK) == 0 ? 0 : -1;
+	}
+
+	/**
+	 * Check if a file, link or folder and everything in it could be removed.
+	 * @param Path.
+	 * @return If every folder involved, including the parent, is writable.
+	 */
+	bool can_remove_tree(const std::string& path)
+	{
+		if (access(ds::get_parent_path(path).c_str(), W_OK | X_OK) != 0)
+			return false;
+
+		return nftw(path.c_str(), check_walked_entry, 64, FTW_PHYS) == 0;
+	}
+}
+
+namespace ds
+{
+	bool remove_tree(const std::string& path)
+	{
+		return nftw(path.c_str(), remove_walked_entry, 64, FTW_DEPTH | FTW_PHYS) == 0;
+	}
+
+	bool move_across_filesystems(const std::string& from, const std::string& to, uint64_t& bytes)
+	{
+		DS_TRACE_SCOPE_DETAIL("copy across filesystems", from);
+
+		// Never merge into or overwrite something already there
+		struct stat existing = {};
+		if (lstat(to.c_str(), &existing) == 0)
+			return false;
+
+		// Otherwise the file would end up in both places
+		if (!can_remove_tree(from))
+			return false;
+
+		uint64_t copied = 0;
+		if (!copy_entry(from, to, copied))
+		{
+			remove_tree(to);
+			return false;
+		}
+
+		// Part of the source may be gone already, so the verified copy is kept rather than risk losing files
+		bytes = copied;
+		return remove_tree(from);
+	}
+
+	bool clone_tree(const std::string& from, const std::string& to, CloneStats& stats)
+	{
+		DS_TRACE_SCOPE_DETAIL("clone", from);
+
+		// Never merge into or overwrite something already there
+		struct stat existing = {};
+		if (lstat(to.c_str(), &existing) == 0)
+			return false;
+
+		// Only count what ends up in the clone
+		CloneContext context = {};
+		uint64_t bytes = 0;
+		if (!copy_entry(from, to, bytes, &context, true))
+		{
+			remove_tree(to);
+			return false;
+		}
+
+		stats.reflinked += context.stats.reflinked;
+		stats.linked += context.stats.linked;
+		stats.copied += context.stats.copied;
+		stats.copied_bytes += context.stats.copied_bytes;
+		return true;
+	}
+}
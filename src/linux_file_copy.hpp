@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * @file linux_file_copy.hpp
+ * @brief Cross filesystem moves and clones on Linux header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstdint>
+#include <string>
+#include "desktop_backend.hpp"
+
+namespace ds
+{
+	/**
+	 * Move a file or folder to another filesystem, where it can't simply be renamed.
+	 * The data is copied, flushed, read back and checked against a hash of the source before the
+	 * source is removed.
+	 * @param Source path.
+	 * @param Destination path, which must not exist.
+	 * @param Number of bytes copied output.
+	 * @return If the file was moved. On failure the source is untouched and nothing is left at the destination,
+	 * unless the source couldn't be removed after the copy. Then the copy is kept, since some of the source may
+	 * already be gone.
+	 */
+	extern bool move_across_filesystems(const std::string& from, const std::string& to, uint64_t& bytes);
+
+	/**
+	 * Remove a file, link or folder and everything in it. Links aren't followed.
+	 * @param Path.
+	 * @return If everything was removed.
+	 */
+	extern bool remove_tree(const std::string& path);
+
+	/**
+	 * Duplicate a file or folder, reflinking files with FICLONE where the filesystem supports it,
+	 * hard linking them if not, and copying them as a last resort.
+	 * @param Source path. Followed if it is a link.
+	 * @param Destination path, which must not exist.
+	 * @param Clone statistics to add to.
+	 * @return If everything was cloned. On failure nothing is left at the destination.
+	 */
+	extern bool clone_tree(const std::string& from, const std::string& to, CloneStats& stats);
+}
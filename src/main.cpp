@@ -1,111 +1,120 @@
 /** Desktop-Saver */
 #include "util.hpp"
+#include "daemon.hpp"
+#include "desktop_backend.hpp"
+#include "move_engine.hpp"
 #include "save_data.hpp"
+#include "trace.hpp"
 
 /** Windows */
-#include <combaseapi.h>
-#include <winerror.h>
-#include <commctrl.h>
-#include <atlbase.h>
-#include <shlobj.h>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+/** Same exit code as the Windows build. */
+#define ERROR_BAD_ARGUMENTS 160
+#endif
 
 /** STL */
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
 
 /**
  * Check's if the Desktop-Saver folder exists, and if not, it creates it and the necessary files.
+ * @param Desktop backend.
+ * @note A marker is written once the folders exist, so later runs only check for the marker and the saves file.
  */
-void check_data_folder()
+void check_data_folder(ds::DesktopBackend& backend)
 {
 	// Get the path to the AppData folder
 	std::string path = ds::get_desktop_saver_path();
 
+	// Skip the folder checks once the folder has been set up, but always repair a missing saves file
+	const std::string marker = ds::join_path(path, ".initialized");
+	std::string saves_file = ds::join_path(path, "saves.json");
+	const bool has_saves_file = backend.file_exists(saves_file);
+	if (has_saves_file && backend.file_exists(marker))
+		return;
+
 	// Create the directory if needed
-	CreateDirectory(path.c_str(), NULL);
+	backend.create_directory(path);
 
 	// Check if the saves file exists
-	std::string saves_file = path + "\\saves.json";
-	if (PathFileExists(saves_file.c_str()) == FALSE)
+	if (!has_saves_file)
 	{
 		// Create the file
 		std::ofstream stream(saves_file);
-		stream << "{ \"active_desktop\" : \"Default\", \"saves\" : [] }";
+		stream << "{ \"active_desktop\" : \"Default\", \"saves\" : [ \"Default\" ] }";
 	}
 
-	// Check if the saves folder exists
-	const std::string saves_folder = path + "\\saves";
-	CreateDirectory(saves_folder.c_str(), NULL);
-
-	// Check the "Default" save folder
-	const std::string default_save_folder = path + "\\saves\\Default";
-	CreateDirectory(default_save_folder.c_str(), NULL);
+	// Check if the saves folder exists (Save folders are created when they are first used)
+	const std::string saves_folder = ds::join_path(path, "saves");
+	backend.create_directory(saves_folder);
 
-	// Check the "Default" save icons folder
-	const std::string default_save_icons = path + "\\saves\\Default\\icons";
-	CreateDirectory(default_save_icons.c_str(), NULL);
+	// Written last, so an interrupted setup runs again
+	std::ofstream stream(marker);
+}
 
-	// Check the "Default" save locations file
-	std::string default_save_loc = path + "\\saves\\Default\\locations.json";
-	if (PathFileExists(default_save_loc.c_str()) == FALSE)
-	{
-		// Create the file
-		std::ofstream stream(default_save_loc);
-		stream << "{ \"icons\" : [] }";
-	}
+/**
+ * Print the help text.
+ * @param Output.
+ */
+void print_help(std::ostream& out)
+{
+	out <<			"-n NAME : Create a \"New\" desktop with the name, NAME.\n"
+					"-c NAME : \"Clone\" the current desktop into a new desktop with the name, NAME, staying on the current one.\n"
+					"-l NAME : \"Load\" the desktop with the name, NAME.\n"
+					"-r      : \"Read\" all the saved desktops.\n"	
+					"-m MODE : Set the storage \"Mode\" to \"move\" (files are moved) or \"link\" (the desktop links to the save).\n"
+					"-d      : Run as a \"Daemon\" that keeps everything loaded and runs the other commands sent to it.\n"
+					"-d stop : Stop the daemon.\n"
+					"-h      : Ask for \"help.\"\n"
+					"--trace FILE : Write a Chrome trace of the command to FILE, for Perfetto or chrome://tracing.";
 }
 
 /**
- * Entry point.
- * @param Number of arguments passed.
- * @param Command line arguments.
- * @note argv[0] is the program name.
+ * Run a command.
+ * @param Save data.
+ * @param Command line arguments, without the program name.
+ * @param Standard output.
+ * @param Standard error.
+ * @return Exit code.
  */
-int main(int argc, char* argv[])
+int run_command(ds::SaveData& save_data, const std::vector<std::string>& args, std::ostream& out, std::ostream& err)
 {
-	// Must take in atleast 2 args (First is the program name)
-	if (argc < 2)
+	if (args.empty())
 	{
-		std::cerr << "ERROR: Missing arguments";
+		err << "ERROR: Missing arguments";
 		return ERROR_BAD_ARGUMENTS;
 	}
 
-	// Initialize the COM library
-	CoInitialize(NULL);
-	
-	// Initialize the Desktop-Saver folder if needed
-	check_data_folder();
-	
-	// Get the desktop saver path
-	const auto& path = ds::get_desktop_saver_path();
-	
-	// Create the saved data manager
-	ds::SaveData save_data(path);
-	
 	// Get the operation
-	const std::string operation = argv[1];
-	
+	const std::string& operation = args[0];
+
 	// Read saved desktops
 	if (operation == "-r")
 	{
 		// Loop over every save
 		for (size_t i = 0; i < save_data.get_save_count(); ++i)
 			// Print out the save name
-			std::cout << save_data.get_save(i).get_name() << '\n';
+			out << save_data.get_save(i).get_name() << '\n';
 	}
 	// New desktop
 	else if (operation == "-n")
 	{
 		// Must have a third argument
-		if (argc < 3)
+		if (args.size() < 2)
 		{
-			std::cerr << "ERROR: Missing save name.";
+			err << "ERROR: Missing save name.";
 			return ERROR_BAD_ARGUMENTS;
 		}
 	
 		// Get the save name
-		const std::string save_name = argv[2];
-		std::cout << "Saving current desktop with name \"" + save_name + "\"\n";
+		const std::string save_name = args[1];
+		out << "Saving current desktop with name \"" + save_name + "\"\n";
 	
 		// Save the desktop
 		ds::NewDesktopResult result = save_data.new_desktop(save_name);
@@ -113,30 +122,81 @@ int main(int argc, char* argv[])
 		switch (result)
 		{
 		case ds::NewDesktopResult::ActiveDesktopInvalid:
-			std::cerr << "ERROR: The active desktop must be valid.";
+			err << "ERROR: The active desktop must be valid.";
 			return 0;
 	
 		case ds::NewDesktopResult::NameTaken:
-			std::cerr << "ERROR: Desktop with that name is already taken.";
+			err << "ERROR: Desktop with that name is already taken.";
+			return 0;
+	
+		case ds::NewDesktopResult::InvalidName:
+			err << "ERROR: A desktop name can't be empty, \".\" or \"..\", or contain slashes.";
+			return ERROR_BAD_ARGUMENTS;
+	
+		case ds::NewDesktopResult::MoveFailed:
+			err << "ERROR: Some files couldn't be moved, so the desktop wasn't saved.";
 			return 0;
 	
 		default:
-			std::cout << "Created new desktop \"" + save_name + "\"";
+			out << "Created new desktop \"" + save_name + "\"";
+		}
+	}
+	// Clone desktop
+	else if (operation == "-c")
+	{
+		// Must have a third argument
+		if (args.size() < 2)
+		{
+			err << "ERROR: Missing save name.";
+			return ERROR_BAD_ARGUMENTS;
+		}
+	
+		// Get the save name
+		const std::string clone_name = args[1];
+		out << "Cloning current desktop with name \"" + clone_name + "\"\n";
+	
+		// Clone the desktop
+		ds::CloneDesktopResult result = save_data.clone_desktop(clone_name);
+	
+		switch (result)
+		{
+		case ds::CloneDesktopResult::ActiveDesktopInvalid:
+			err << "ERROR: The active desktop must be valid.";
+			return 0;
+	
+		case ds::CloneDesktopResult::NameTaken:
+			err << "ERROR: Desktop with that name is already taken.";
+			return 0;
+	
+		case ds::CloneDesktopResult::InvalidName:
+			err << "ERROR: A desktop name can't be empty, \".\" or \"..\", or contain slashes.";
+			return ERROR_BAD_ARGUMENTS;
+	
+		case ds::CloneDesktopResult::CloneFailed:
+			err << "ERROR: Unable to copy the files of the current desktop.";
+			return 0;
+	
+		default:
+		{
+			const ds::CloneStats& stats = save_data.get_clone_stats();
+			out << "Cloned desktop \"" + clone_name + "\" (" << stats.reflinked << " reflinked, " <<
+				stats.linked << " hard linked, " << stats.copied << " copied)";
+		}
 		}
 	}
 	// Load desktop
 	else if (operation == "-l")
 	{
 		// Must have a third argument
-		if (argc < 3)
+		if (args.size() < 2)
 		{
-			std::cerr << "ERROR: Missing save name.";
+			err << "ERROR: Missing save name.";
 			return ERROR_BAD_ARGUMENTS;
 		}
 	
 		// Get the load name
-		const std::string load_name = argv[2];
-		std::cout << "Loading current desktop with name \"" + load_name + "\"\n";
+		const std::string load_name = args[1];
+		out << "Loading current desktop with name \"" + load_name + "\"\n";
 	
 		// Load the desktop
 		ds::LoadDesktopResult result = save_data.load_desktop(load_name);
@@ -144,35 +204,254 @@ int main(int argc, char* argv[])
 		switch (result)
 		{
 		case ds::LoadDesktopResult::InvalidSaveName:
-			std::cerr << "ERROR: A save with that name does not exist.";
+			err << "ERROR: A save with that name does not exist.";
 			return 0;
 	
 		case ds::LoadDesktopResult::ActiveDesktopInvalid:
-			std::cerr << "ERROR: The active desktop is invalid.";
+			err << "ERROR: The active desktop is invalid.";
 			return 0;
 	
 		case ds::LoadDesktopResult::CantLoadActiveDesktop:
-			std::cerr << "ERROR: Already the active desktop";
+			err << "ERROR: Already the active desktop";
+			return 0;
+	
+		case ds::LoadDesktopResult::MoveFailed:
+			err << "ERROR: Some files couldn't be moved, so the desktop wasn't switched.";
 			return 0;
 	
+		case ds::LoadDesktopResult::Interrupted:
+			err << "ERROR: The switch couldn't finish. It will be completed on the next run.";
+			return 1;
+	
 		default:
-			std::cout << "Loaded save \"" + load_name + "\"";
+			out << "Loaded save \"" + load_name + "\"";
 		}
 	}
-	// Help
-	else if (operation == "-h")
+	// Storage mode
+	else if (operation == "-m")
 	{
-		std::cout <<	"-n NAME : Create a \"New\" desktop with the name, NAME.\n"
-						"-l NAME : \"Load\" the desktop with the name, NAME.\n"
-						"-r      : \"Read\" all the saved desktops.\n"	
-						"-h      : Ask for \"help.\"";
+		// Must have a third argument
+		if (args.size() < 2)
+		{
+			err << "ERROR: Missing storage mode.";
+			return ERROR_BAD_ARGUMENTS;
+		}
+	
+		// Get the storage mode
+		const std::string mode_name = args[1];
+		ds::StorageMode mode = ds::StorageMode::Move;
+		if (mode_name == "link")
+			mode = ds::StorageMode::Link;
+		else if (mode_name != "move")
+		{
+			err << "ERROR: Storage mode must be \"move\" or \"link\".";
+			return ERROR_BAD_ARGUMENTS;
+		}
+	
+		// Change the storage mode
+		ds::SetStorageModeResult result = save_data.set_storage_mode(mode);
+	
+		switch (result)
+		{
+		case ds::SetStorageModeResult::ActiveDesktopInvalid:
+			err << "ERROR: The active desktop is invalid.";
+			return 0;
+	
+		case ds::SetStorageModeResult::Unsupported:
+			err << "ERROR: Unable to change the storage mode on this desktop.";
+			return 0;
+	
+		default:
+			out << "Storage mode set to \"" + mode_name + "\"";
+		}
 	}
+	// Help
+	else if (operation == "-h")
+		print_help(out);
 	// Invalid argument
 	else
 	{
-		std::cerr << "ERROR: Invalid argument.";
+		err << "ERROR: Invalid argument.";
 		return ERROR_BAD_ARGUMENTS;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+/**
+ * Run the command line, with only what the command needs set up.
+ * @param Command line arguments, without the program name.
+ * @param If a trace is being recorded.
+ * @return Exit code.
+ */
+int run_cli(const std::vector<std::string>& args, bool tracing)
+{
+	// Get the operation
+	const std::string& operation = args[0];
+
+	// Help doesn't need anything set up
+	if (operation == "-h")
+	{
+		print_help(std::cout);
+		return 0;
+	}
+
+	// Get the desktop saver path
+	const auto& path = ds::get_desktop_saver_path();
+
+	// Listing saves only needs the saves file, unless the last operation has to be finished first
+	if (operation == "-r")
+	{
+		ds::CatalogFile catalog = {};
+		if (ds::SaveData::read_catalog(path, catalog))
+		{
+			for (const auto& name : catalog.saves)
+				std::cout << name << '\n';
+			return 0;
+		}
+	}
+
+	// Stopping the daemon only needs the socket
+	const std::string socket_path = ds::get_daemon_socket_path(path);
+	if (operation == "-d" && args.size() > 1 && args[1] == "stop")
+	{
+		if (!ds::Daemon::stop(socket_path))
+		{
+			std::cerr << "ERROR: The daemon isn't running.";
+			return 1;
+		}
+
+		std::cout << "Daemon stopped";
+		return 0;
+	}
+
+	// Let a running daemon do the work, since it has everything loaded already (Traces are of this process)
+	ds::CommandResult result = {};
+	if (!tracing && operation != "-d" && ds::Daemon::send(socket_path, args, result))
+	{
+		std::cout << result.out;
+		std::cerr << result.err;
+		return result.exit_code;
+	}
+
+	// A daemon keeps the save data loaded, so changing it behind the daemon's back would leave it stale
+	if (operation != "-d" && ds::Daemon::is_running(socket_path))
+	{
+		if (tracing)
+			std::cerr << "ERROR: The daemon is running. Stop it to trace a command.";
+		else
+			std::cerr << "ERROR: The daemon is running but didn't answer. Stop it with \"-d stop\" and try again.";
+		return 1;
+	}
+
+	// Create the desktop backend (Initializes COM on Windows)
+	auto backend = ds::create_desktop_backend();
+	
+	// Initialize the Desktop-Saver folder if needed
+	check_data_folder(*backend);
+	
+	// Create the file mover
+	ds::MoveEngine move_engine(*backend);
+	
+	// Create the saved data manager
+	std::unique_ptr<ds::SaveData> save_data(new ds::SaveData(path, *backend, move_engine));
+
+	// Daemon
+	if (operation == "-d")
+	{
+		// What the saves file looked like after the last command, to notice anyone else changing it
+		const std::string saves_file = ds::join_path(path, "saves.json");
+		ds::FileInfo saves_info = {};
+		backend->get_file_info(saves_file, saves_info);
+
+		try
+		{
+			ds::Daemon daemon(socket_path, [&](const std::vector<std::string>& command, std::ostream& out, std::ostream& err)
+			{
+				// Reload if another process changed the saves, or after a command failed part way, which also finishes it from the journal
+				ds::FileInfo info = {};
+				backend->get_file_info(saves_file, info);
+				if (info.id != saves_info.id || info.size != saves_info.size || info.modified != saves_info.modified)
+					save_data.reset();
+
+				if (!save_data)
+					save_data.reset(new ds::SaveData(path, *backend, move_engine));
+
+				try
+				{
+					const int exit_code = run_command(*save_data, command, out, err);
+					backend->get_file_info(saves_file, saves_info);
+					return exit_code;
+				}
+				catch (...)
+				{
+					save_data.reset();
+					throw;
+				}
+			});
+
+			std::cout << "Daemon listening on \"" + socket_path + "\"" << std::endl;
+			daemon.run();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what();
+			return 1;
+		}
+
+		return 0;
+	}
+
+	return run_command(*save_data, args, std::cout, std::cerr);
+}
+
+/**
+ * Entry point.
+ * @param Number of arguments passed.
+ * @param Command line arguments.
+ * @note argv[0] is the program name.
+ */
+int main(int argc, char* argv[])
+{
+	// Take out the trace option, which can go anywhere
+	std::vector<std::string> args = {};
+	std::string trace_path = "";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) != "--trace")
+			args.push_back(argv[i]);
+		else if (i + 1 < argc)
+			trace_path = argv[++i];
+		else
+		{
+			std::cerr << "ERROR: Missing trace file.";
+			return ERROR_BAD_ARGUMENTS;
+		}
+	}
+
+	// Must take in atleast 2 args (First is the program name)
+	if (args.empty())
+	{
+		std::cerr << "ERROR: Missing arguments";
+		return ERROR_BAD_ARGUMENTS;
+	}
+
+	// Record spans until the command is done
+	const bool tracing = !trace_path.empty();
+	if (tracing && !ds::Tracer::start(trace_path))
+	{
+		std::cerr << "ERROR: This build doesn't support tracing.";
+		return ERROR_BAD_ARGUMENTS;
+	}
+
+	// Anything thrown means the command couldn't finish. The journal completes it on the next run.
+	int exit_code = 1;
+	try
+	{ exit_code = run_cli(args, tracing); }
+	catch (const std::exception& e)
+	{ std::cerr << "ERROR: " << e.what(); }
+
+	if (tracing && !ds::Tracer::stop())
+		std::cerr << "ERROR: Unable to write the trace file.";
+
+	return exit_code;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file manifest.cpp
+ * @brief Desktop manifest source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <utility>
+#include "json_arena.hpp"
+#include "manifest.hpp"
+#include "trace.hpp"
+
+namespace
+{
+	/**
+	 * Check if two entries describe the same file.
+	 * @param First entry.
+	 * @param Second entry.
+	 * @return If the files are the same.
+	 */
+	bool same_file(const ds::ManifestEntry& e1, const ds::ManifestEntry& e2)
+	{
+		return e1.info.id == e2.info.id && e1.info.size == e2.info.size &&
+			e1.info.modified == e2.info.modified && e1.info.directory == e2.info.directory;
+	}
+
+	/**
+	 * Check if two entries have the same icon.
+	 * @param First entry.
+	 * @param Second entry.
+	 * @return If the icons are the same.
+	 */
+	bool same_icon(const ds::ManifestEntry& e1, const ds::ManifestEntry& e2)
+	{
+		if (e1.placed != e2.placed) return false;
+		return !e1.placed || (e1.point.x == e2.point.x && e1.point.y == e2.point.y);
+	}
+
+	/**
+	 * Check if an entry sorts before another.
+	 * @param First entry.
+	 * @param Second entry.
+	 * @return If the first entry goes first.
+	 */
+	bool entry_before(const ds::ManifestEntry& e1, const ds::ManifestEntry& e2)
+	{
+		const int order = e1.name.compare(e2.name);
+		return order < 0 || (order == 0 && e1.occurrence < e2.occurrence);
+	}
+}
+
+namespace ds
+{
+	Manifest Manifest::scan(DesktopBackend& backend, const std::string& path, const std::vector<DesktopIcon>& icons)
+	{
+		DS_TRACE_SCOPE("Manifest::scan");
+
+		// Keyed by name and occurrence, so icons sharing a name are compared one to one
+		std::map<std::pair<std::string, size_t>, ManifestEntry> entries = {};
+
+		// Every file in the folder, whose names are unique
+		for (const auto& name : backend.list_files(path))
+		{
+			ManifestEntry& entry = entries[std::make_pair(name, size_t(0))];
+			entry.name = name;
+			backend.get_file_info(join_path(path, name), entry.info);
+		}
+
+		// Every icon, which may not have a file of the same name (The recycle bin, hidden extensions)
+		std::map<std::string, size_t> occurrences = {};
+		for (const auto& icon : icons)
+		{
+			const size_t occurrence = occurrences[icon.name]++;
+			ManifestEntry& entry = entries[std::make_pair(icon.name, occurrence)];
+			entry.name = icon.name;
+			entry.occurrence = occurrence;
+			entry.point = icon.point;
+			entry.placed = true;
+		}
+
+		Manifest manifest = {};
+		manifest.m_entries.reserve(entries.size());
+		for (auto& entry : entries)
+			manifest.m_entries.push_back(std::move(entry.second));
+
+		return manifest;
+	}
+
+	Manifest Manifest::read(const std::string& path)
+	{
+		DS_TRACE_SCOPE("Manifest::read");
+
+		Manifest manifest = {};
+
+		std::ifstream stream(path);
+		if (!stream) return manifest;
+
+		// The document only lives as long as this read
+		JsonArena arena;
+		try
+		{
+			arena_json j = {};
+			j << stream;
+
+			for (const auto& e : j.at("entries"))
+			{
+				ManifestEntry entry = {};
+				entry.name = e.at("name").get<std::string>();
+				entry.info.id = e.at("id").get<uint64_t>();
+				entry.info.size = e.at("size").get<uint64_t>();
+				entry.info.modified = e.at("modified").get<int64_t>();
+				entry.info.directory = e.at("directory").get<bool>();
+
+				if (e.find("location") != e.end())
+				{
+					entry.point.x = e["location"].at(0).get<int32_t>();
+					entry.point.y = e["location"].at(1).get<int32_t>();
+					entry.placed = true;
+				}
+
+				manifest.m_entries.push_back(std::move(entry));
+			}
+		}
+		catch (...)
+		{
+			// An empty manifest makes the next save rewrite everything
+			return Manifest();
+		}
+
+		// Files written by hand may be out of order. Entries sharing a name keep the order they were saved in.
+		std::stable_sort(manifest.m_entries.begin(), manifest.m_entries.end(), [](const ManifestEntry& e1, const ManifestEntry& e2)
+		{
+			return e1.name < e2.name;
+		});
+
+		for (size_t i = 1; i < manifest.m_entries.size(); ++i)
+			if (manifest.m_entries[i].name == manifest.m_entries[i - 1].name)
+				manifest.m_entries[i].occurrence = manifest.m_entries[i - 1].occurrence + 1;
+
+		return manifest;
+	}
+
+	std::string Manifest::dump() const
+	{
+		DS_TRACE_SCOPE("Manifest::dump");
+
+		JsonArena arena;
+		arena_json j = {};
+		j["entries"] = arena_json::array();
+
+		for (const auto& entry : m_entries)
+		{
+			arena_json e = {};
+			e["name"] = entry.name;
+			e["id"] = entry.info.id;
+			e["size"] = entry.info.size;
+			e["modified"] = entry.info.modified;
+			e["directory"] = entry.info.directory;
+
+			if (entry.placed)
+			{
+				e["location"][0] = entry.point.x;
+				e["location"][1] = entry.point.y;
+			}
+
+			j["entries"].push_back(std::move(e));
+		}
+
+		return j.dump(4);
+	}
+
+	ManifestDiff Manifest::diff(const Manifest& old) const
+	{
+		ManifestDiff diff = {};
+
+		// Both lists are sorted, so walk them side by side
+		size_t i = 0;
+		size_t j = 0;
+		while (i < m_entries.size() || j < old.m_entries.size())
+		{
+			if (j == old.m_entries.size() || (i < m_entries.size() && entry_before(m_entries[i], old.m_entries[j])))
+			{
+				diff.layout_changed |= m_entries[i].placed;
+				++diff.added;
+				++i;
+			}
+			else if (i == m_entries.size() || entry_before(old.m_entries[j], m_entries[i]))
+			{
+				diff.layout_changed |= old.m_entries[j].placed;
+				++diff.removed;
+				++j;
+			}
+			else
+			{
+				const bool icon = same_icon(m_entries[i], old.m_entries[j]);
+				diff.layout_changed |= !icon;
+				if (!icon || !same_file(m_entries[i], old.m_entries[j]))
+					++diff.changed;
+				++i;
+				++j;
+			}
+		}
+
+		return diff;
+	}
+}
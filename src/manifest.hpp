@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * @file manifest.hpp
+ * @brief Desktop manifest header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "desktop_backend.hpp"
+#include "util.hpp"
+
+namespace ds
+{
+	/**
+	 * What a saved desktop knows about one of its files.
+	 */
+	struct ManifestEntry
+	{
+		/** Name. */
+		std::string name = "";
+
+		/** Index among the entries with the same name, since icons can share one (hidden extensions). */
+		size_t occurrence = 0;
+
+		/** File information, all zero if there is no file by that name. */
+		FileInfo info = {};
+
+		/** Icon location. */
+		IconPoint point = {};
+
+		/** If the desktop has an icon by that name. */
+		bool placed = false;
+	};
+
+	/**
+	 * Differences between two manifests.
+	 */
+	struct ManifestDiff
+	{
+		/** Number of entries that are new. */
+		size_t added = 0;
+
+		/** Number of entries that are gone. */
+		size_t removed = 0;
+
+		/** Number of entries whose file or icon changed. */
+		size_t changed = 0;
+
+		/** If any icon was added, removed or moved. */
+		bool layout_changed = false;
+
+		/**
+		 * Check if nothing changed.
+		 * @return If the manifests are the same.
+		 */
+		inline bool empty() const noexcept;
+	};
+
+	/**
+	 * Record of the files and icons of a desktop at the time it was saved.
+	 */
+	class Manifest
+	{
+	public:
+
+		Manifest() = default;
+
+		/**
+		 * Describe a folder and the icons showing it.
+		 * @param Desktop backend.
+		 * @param Folder path.
+		 * @param Desktop icons.
+		 * @return Manifest.
+		 */
+		static Manifest scan(DesktopBackend& backend, const std::string& path, const std::vector<DesktopIcon>& icons);
+
+		/**
+		 * Read a manifest file.
+		 * @param File path.
+		 * @return Manifest, or an empty manifest if the file is missing or damaged.
+		 */
+		static Manifest read(const std::string& path);
+
+		/**
+		 * Serialize the manifest.
+		 * @return Contents of a manifest file.
+		 */
+		std::string dump() const;
+
+		/**
+		 * Compare against an older manifest.
+		 * @param Older manifest.
+		 * @return What changed since then.
+		 */
+		ManifestDiff diff(const Manifest& old) const;
+
+		/**
+		 * Get the entries, sorted by name and occurrence.
+		 * @return Entries.
+		 */
+		inline const std::vector<ManifestEntry>& get_entries() const noexcept;
+
+	private:
+
+		/** Entries, sorted by name and occurrence. */
+		std::vector<ManifestEntry> m_entries = {};
+	};
+}
+
+#include "manifest.imp.hpp"
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * @file manifest.imp.hpp
+ * @brief Desktop manifest header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline bool ManifestDiff::empty() const noexcept
+	{
+		return added == 0 && removed == 0 && changed == 0;
+	}
+
+	inline const std::vector<ManifestEntry>& Manifest::get_entries() const noexcept
+	{
+		return m_entries;
+	}
+}
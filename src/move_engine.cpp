@@ -0,0 +1,59 @@
+/**
+ * @file move_engine.cpp
+ * @brief File move engine source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <chrono>
+#include "move_engine.hpp"
+#include "trace.hpp"
+
+namespace ds
+{
+	MoveEngine::MoveEngine(DesktopBackend& backend, size_t worker_count) :
+		m_backend(backend),
+		m_pool(worker_count)
+	{
+
+	}
+
+	MoveReport MoveEngine::run(const std::vector<FileMove>& moves)
+	{
+		DS_TRACE_SCOPE("MoveEngine::run");
+
+		const auto start = std::chrono::steady_clock::now();
+		const CopyStats copies = m_backend.get_copy_stats();
+
+		// std::vector<bool> packs bits, so workers write to bytes instead
+		std::vector<char> moved(moves.size(), 0);
+
+		m_pool.parallel_for(moves.size(), [&](size_t i)
+		{
+			DS_TRACE_SCOPE_DETAIL("move file", moves[i].from);
+			moved[i] = m_backend.move_file(moves[i].from, moves[i].to) ? 1 : 0;
+		});
+
+		// Gather results
+		MoveReport report = {};
+		report.moved.resize(moves.size());
+		for (size_t i = 0; i < moves.size(); ++i)
+		{
+			report.moved[i] = moved[i] != 0;
+			if (report.moved[i])
+				++report.moved_count;
+			else
+				++report.failed_count;
+		}
+
+		// Moves between filesystems copy their data
+		const CopyStats copied = m_backend.get_copy_stats();
+		report.copied_count = copied.files - copies.files;
+		report.copied_bytes = copied.bytes - copies.bytes;
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		report.seconds = elapsed.count();
+
+		return report;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+/**
+ * @file move_engine.hpp
+ * @brief File move engine header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "desktop_backend.hpp"
+#include "thread_pool.hpp"
+
+namespace ds
+{
+	/**
+	 * A file to move.
+	 */
+	struct FileMove
+	{
+		/** Source path. */
+		std::string from = "";
+
+		/** Destination path. */
+		std::string to = "";
+	};
+
+	/**
+	 * Result of a batch of moves.
+	 */
+	struct MoveReport
+	{
+		/** If each file was moved, in the same order as the batch. */
+		std::vector<bool> moved = {};
+
+		/** Number of files moved. */
+		size_t moved_count = 0;
+
+		/** Number of files that failed to move. */
+		size_t failed_count = 0;
+
+		/** Number of files that had to be copied to another filesystem. */
+		size_t copied_count = 0;
+
+		/** Number of bytes copied to another filesystem. */
+		uint64_t copied_bytes = 0;
+
+		/** Time taken in seconds. */
+		double seconds = 0.0;
+
+		/**
+		 * Get the number of files moved per second.
+		 * @return Throughput.
+		 */
+		inline double get_files_per_second() const noexcept;
+
+		/**
+		 * Get the number of bytes copied to another filesystem per second.
+		 * @return Throughput.
+		 */
+		inline double get_copied_bytes_per_second() const noexcept;
+	};
+
+	/**
+	 * Moves batches of files across a pool of worker threads.
+	 */
+	class MoveEngine
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Desktop backend.
+		 * @param Number of workers. 0 uses the number of cores.
+		 */
+		MoveEngine(DesktopBackend& backend, size_t worker_count = 0);
+
+		/**
+		 * Move every file in a batch.
+		 * @param Files to move.
+		 * @return Per file results and throughput.
+		 */
+		MoveReport run(const std::vector<FileMove>& moves);
+
+		/**
+		 * Get the number of workers.
+		 * @return Number of workers.
+		 */
+		inline size_t get_worker_count() const noexcept;
+
+	private:
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+
+		/** Workers. */
+		ThreadPool m_pool;
+	};
+}
+
+#include "move_engine.imp.hpp"
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+ * @file move_engine.imp.hpp
+ * @brief File move engine header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline double MoveReport::get_files_per_second() const noexcept
+	{
+		return seconds > 0.0 ? static_cast<double>(moved_count) / seconds : 0.0;
+	}
+
+	inline double MoveReport::get_copied_bytes_per_second() const noexcept
+	{
+		return seconds > 0.0 ? static_cast<double>(copied_bytes) / seconds : 0.0;
+	}
+
+	inline size_t MoveEngine::get_worker_count() const noexcept
+	{
+		return m_pool.get_thread_count();
+	}
+}
\ No newline at end of file
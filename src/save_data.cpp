@@ -5,328 +5,681 @@
  */
 
 /** Includes. */
+#include <algorithm>
 #include <fstream>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include "json_arena.hpp"
+#include "json_reader.hpp"
+#include "layout_index.hpp"
+#include "layout_json.hpp"
 #include "save_data.hpp"
+#include "trace.hpp"
 #include "util.hpp"
 
-/** Windows */
-#include <combaseapi.h>
-#include <winerror.h>
-#include <commctrl.h>
-#include <atlbase.h>
-#include <shlobj.h>
-
 namespace
 {
+	/** How long to wait for the desktop view to catch up before carrying on anyway. */
+	constexpr std::chrono::milliseconds view_timeout(5000);
+
+	/** How often to check on background moves while positioning icons. */
+	constexpr std::chrono::milliseconds pipeline_step(10);
+
+	/** Marks an empty slot in the desktop catalog. */
+	constexpr size_t no_desktop = static_cast<size_t>(-1);
+
 	/**
-	 * Get a list of desktop icons.
-	 * @param Desktop folder view.
-	 * @param Desktop shell folder.
-	 * @return Desktop icons.
+	 * Get the work the view did between two points.
+	 * @param Statistics before.
+	 * @param Statistics after.
+	 * @return Difference.
 	 */
-	std::vector<ds::DesktopIcon> get_desktop_icons(CComPtr<IFolderView2>& view, CComPtr<IShellFolder>& shell)
+	ds::ViewStats get_stats_since(const ds::ViewStats& before, const ds::ViewStats& after)
 	{
-		// Get the number of icons
-		int icon_count = -1;
-		view->ItemCount(SVGIO_ALLVIEW, &icon_count);
-		if (icon_count == -1) throw std::runtime_error("Unable to get the number of icons.");
-
-		// List of icons
-		std::vector<ds::DesktopIcon> icons(static_cast<size_t>(icon_count));
+		ds::ViewStats stats = {};
+		stats.refreshes = after.refreshes - before.refreshes;
+		stats.repaints = after.repaints - before.repaints;
+		return stats;
+	}
 
-		// Ask for an item enumeration object
-		CComPtr<IEnumIDList> item_enum = nullptr;
-		view->Items(SVGIO_ALLVIEW, IID_PPV_ARGS(&item_enum));
-		if (item_enum == nullptr) throw std::runtime_error("Unable to get item enumerator.");
+	/**
+	 * Check if a save name can be used as the name of its folder.
+	 * @param Save name.
+	 * @return If the save folder would be a single new entry in the saves folder.
+	 */
+	bool is_valid_save_name(const std::string& name)
+	{
+		return !name.empty() && name != "." && name != ".." &&
+			name.find(ds::path_separator) == std::string::npos && name.find('/') == std::string::npos;
+	}
 
-		// Loop over every item
-		size_t i = 0;
-		for (CComHeapPtr<ITEMID_CHILD> item; item_enum->Next(1, &item, nullptr) == S_OK; item.Free())
+	/**
+	 * Move back the files a batch of moves moved.
+	 * @param Move engine.
+	 * @param Moves.
+	 * @param Report of the moves.
+	 */
+	void undo_moves(ds::MoveEngine& move_engine, const std::vector<ds::FileMove>& moves, const ds::MoveReport& report)
+	{
+		std::vector<ds::FileMove> undo = {};
+		for (size_t i = 0; i < moves.size(); ++i)
 		{
-			// Get the icon's name
-			STRRET str = {};
-			shell->GetDisplayNameOf(item, SHGDN_NORMAL, &str);
-			CComHeapPtr<char> name = {};
-			StrRetToStr(&str, item, &name);
-
-			// Get the icon's location
-			POINT pt = {};
-			view->GetItemPosition(item, &pt);
-
-			// Store icon data
-			icons[i].name = name;
-			icons[i].point = pt;
+			if (!report.moved[i]) continue;
 
-			++i;
+			ds::FileMove move = {};
+			move.from = moves[i].to;
+			move.to = moves[i].from;
+			undo.push_back(std::move(move));
 		}
 
-		return icons;
+		move_engine.run(undo);
 	}
 }
 
 namespace ds
 {
-	SavedDesktop::SavedDesktop(const std::string& name, const std::string& path) :
-		m_name(name), 
-		m_path(path)
+	SavedDesktop::SavedDesktop(const std::string& name, const std::string& path, DesktopBackend& backend, MoveEngine& move_engine) :
+		m_name(name),
+		m_path(path),
+		m_backend(backend),
+		m_move_engine(move_engine)
 	{
-		// Make sure the folder exists
-		CreateDirectory(path.c_str(), NULL);
 
-		// Make sure the icon folder exists
-		const std::string icon_folder = path + "\\icons";
-		CreateDirectory(icon_folder.c_str(), NULL);
-
-		// Check if the locations file exists
-		std::string loc_file = path + "\\locations.json";
-		if (PathFileExists(loc_file.c_str()) == FALSE)
-		{
-			// Create the file
-			std::ofstream stream(loc_file);
-			stream << "{ \"icons\" : [] }";
-		}
 	}
 
-	void SavedDesktop::save()
+	void SavedDesktop::create_folders()
 	{
-		// Get a folder view for the desktop
-		CComPtr<IFolderView2> desktop_view = nullptr;
-		ds::find_desktop_folder_view(IID_PPV_ARGS(&desktop_view));
-		if (desktop_view == nullptr) throw std::runtime_error("Unable to locate a desktop view.");
+		if (m_folders_created) return;
+
+		m_backend.create_directory(m_path);
+		m_backend.create_directory(get_icons_path());
+		m_folders_created = true;
+	}
 
-		// Ask for the folder aswell
-		CComPtr<IShellFolder> desktop_folder = nullptr;
-		desktop_view->GetFolder(IID_PPV_ARGS(&desktop_folder));
-		if (desktop_folder == nullptr) throw std::runtime_error("Unable to locate a desktop folder.");
+	SavePlan SavedDesktop::plan_save(SwitchJournal& journal)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::plan_save");
 
 		// Icons folder
-		const std::string icons_path = m_path + "\\icons";
+		const std::string icons_path = get_icons_path();
 
 		// Create the folders if needed
-		CreateDirectory(m_path.c_str(), NULL);
-		CreateDirectory(icons_path.c_str(), NULL);
+		create_folders();
 
 		// Save information about every icon
-		json icon_info = {};
-		const auto icons = get_desktop_icons(desktop_view, desktop_folder);
-		for (size_t i = 0; i < icons.size(); ++i)
-		{
-			// Save icon name and position
-			icon_info["icons"][i]["name"] = icons[i].name;
-			icon_info["icons"][i]["location"][0] = icons[i].point.x;
-			icon_info["icons"][i]["location"][1] = icons[i].point.y;
-		}
+		SavePlan plan = plan_layout(m_backend.get_icons(), journal);
 
 		// Save the icons
-		const std::string desktop_path = get_desktop_path();
-		const auto names = get_desktop_file_names();
-		for (const auto& icon_name : names)
+		const std::string desktop_path = m_backend.get_desktop_path();
+		const auto names = m_backend.list_files(desktop_path);
+		plan.moves.resize(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
 		{
 			// Path to icon
-			const std::string icon_path = desktop_path + "\\" + icon_name;
+			plan.moves[i].from = join_path(desktop_path, names[i]);
 
 			// New icon path
-			const std::string new_icon_path = icons_path + "\\" + icon_name;
-
-			// Move the icon
-			MoveFileEx(icon_path.c_str(), new_icon_path.c_str(), MOVEFILE_WRITE_THROUGH);
+			plan.moves[i].to = join_path(icons_path, names[i]);
 		}
 
-		// Force the desktop to update
-		// SHChangeNotify(SHCNE_ASSOCCHANGED, SHCNF_FLUSH, NULL, NULL);
+		journal.log_moves(plan.moves);
+
+		return plan;
+	}
+
+	MoveReport SavedDesktop::save(const SavePlan& plan, CommitGroup& commit)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::save");
+
+		// Move the icons
+		const MoveReport report = move_out(plan, commit);
 
 		// Force the desktop to update
-		SendMessage(GetDesktopWindow(), WM_KEYDOWN, VK_F5, 0);
+		m_backend.refresh();
+
+		// Wait until the files are gone from the view, but don't hang if virtual items keep the count up
+		if (!plan.moves.empty())
+			m_backend.wait_for_items([&](size_t count) { return count < plan.icons.size(); }, view_timeout);
 
-		// Wait until the only icon left is the recycle bin
-		int new_icon_count = static_cast<int>(icons.size());
-		while (new_icon_count >= icons.size())
-			desktop_view->ItemCount(SVGIO_ALLVIEW, &new_icon_count);
+		// Save
+		save_layout(plan, commit);
+		return report;
+	}
+
+	MoveReport SavedDesktop::move_out(const SavePlan& plan, CommitGroup& commit)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::move_out");
 
-		// Save 
-		std::ofstream icon_info_stream(m_path + "\\locations.json");
-		icon_info_stream << icon_info.dump(4);
+		MoveReport report = m_move_engine.run(plan.moves);
+		commit.touch_directory(m_backend.get_desktop_path());
+		commit.touch_directory(get_icons_path());
+		return report;
 	}
 
-	void SavedDesktop::load()
+	LoadPlan SavedDesktop::plan_load(SwitchJournal& journal)
 	{
-		// Get a folder view for the desktop
-		CComPtr<IFolderView2> desktop_view = nullptr;
-		ds::find_desktop_folder_view(IID_PPV_ARGS(&desktop_view));
-		if (desktop_view == nullptr) throw std::runtime_error("Unable to locate a desktop view.");
+		DS_TRACE_SCOPE("SavedDesktop::plan_load");
 
-		// Ask for the folder aswell
-		CComPtr<IShellFolder> desktop_folder = nullptr;
-		desktop_view->GetFolder(IID_PPV_ARGS(&desktop_folder));
-		if (desktop_folder == nullptr) throw std::runtime_error("Unable to locate a desktop folder.");
-		
 		// Icons folder
-		const std::string icons_path = m_path + "\\icons";
+		const std::string icons_path = get_icons_path();
 
 		// Get path to desktop
-		const std::string desktop_path = get_desktop_path();
+		const std::string desktop_path = m_backend.get_desktop_path();
 
-		// Read the desktop icons
-		std::ifstream icon_stream(m_path + "\\locations.json");
-		json icon_info = {};
-		icon_info << icon_stream;
-		icon_stream.close();
+		// A save that was never written has nothing to move
+		create_folders();
 
-		// List of icon names
-		std::vector<std::string> names = {};
+		// Read the desktop icons
+		LoadPlan plan = {};
+		plan.layout = read_layout();
 
-		WIN32_FIND_DATA ffd = {};
-		HANDLE file = FindFirstFile((icons_path + "\\*").c_str(), &ffd);
-		do
+		// Move every saved file back onto the desktop
+		const auto names = m_backend.list_files(icons_path);
+		plan.moves.resize(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
 		{
-			// File name
-			const std::string file_name = std::string(ffd.cFileName);
-
 			// Path to icon
-			const std::string icon_path = icons_path + "\\" + file_name;
+			plan.moves[i].from = join_path(icons_path, names[i]);
 
 			// New icon path
-			const std::string new_icon_path = desktop_path + "\\" + file_name;
+			plan.moves[i].to = join_path(desktop_path, names[i]);
+		}
 
-			// Move the icon
-			MoveFileEx(icon_path.c_str(), new_icon_path.c_str(), MOVEFILE_WRITE_THROUGH);
+		journal.log_moves(plan.moves);
 
-		} while (FindNextFile(file, &ffd) != FALSE);
+		return plan;
+	}
 
-		// TODO: Hide the icons
+	MoveReport SavedDesktop::load(LoadPlan& plan, CommitGroup& commit, const std::function<void()>& overlap)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::load");
 
-		// Wait until the icons update
-		int new_icon_count = 0;
-		while (new_icon_count < icon_info["icons"].size())
-		{
-			// Get icon count
-			desktop_view->ItemCount(SVGIO_ALLVIEW, &new_icon_count);
-		}
+		// Hold off repainting until every icon is back in place
+		QuietRestore quiet(m_backend);
 
-		// Force the desktop to update
-		SendMessage(GetDesktopWindow(), WM_KEYDOWN, VK_F5, 0);
+		// Move the icons in the background
+		auto moves = std::async(std::launch::async, [&] { return m_move_engine.run(plan.moves); });
+		commit.touch_directory(get_icons_path());
+		commit.touch_directory(m_backend.get_desktop_path());
 
-		// Disable alignment to grid
-		desktop_view->SetCurrentFolderFlags(FWF_AUTOARRANGE | FWF_SNAPTOGRID, 0);
+		// Get other work out of the way while the files move
+		if (overlap) overlap();
 
-		// Ask for an item enumeration object
-		CComPtr<IEnumIDList> item_enum = nullptr;
-		desktop_view->Items(SVGIO_ALLVIEW, IID_PPV_ARGS(&item_enum));
-		if (item_enum == nullptr) throw std::runtime_error("Unable to get item enumerator.");
+		// Index the saved icons by name
+		const size_t saved_count = plan.layout.get_icon_count();
+		LayoutIndex index(plan.layout);
 
-		// Move the icons back
-		size_t i = 0;
-		for (CComHeapPtr<ITEMID_CHILD> item; item_enum->Next(1, &item, nullptr) == S_OK; item.Free())
+		// Number of icons not positioned yet, and of items enumerated so far
+		size_t unplaced = saved_count;
+		size_t enumerated = 0;
+
+		// Disable alignment to grid
+		m_backend.set_grid_alignment(false);
+
+		// Position icons as they show up, until every one is back or the view stops catching up
+		bool moved = false;
+		size_t shown = 0;
+		size_t expected = 0;
+		auto deadline = std::chrono::steady_clock::time_point::max();
+		while (unplaced > 0)
 		{
-			// Get the icon's name
-			STRRET str = {};
-			desktop_folder->GetDisplayNameOf(item, SHGDN_NORMAL, &str);
-			CComHeapPtr<char> name = {};
-			StrRetToStr(&str, item, &name);
-
-			// Loop over every one of our icons
-			for (size_t j = 0; j < icon_info["icons"].size(); ++j)
+			// Once every file is in place, make sure the view notices all of them
+			if (!moved && moves.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
 			{
-				const auto& icon = icon_info["icons"][j];
+				moved = true;
+				deadline = std::chrono::steady_clock::now() + view_timeout;
+				m_backend.refresh();
 
-				// If the names are the same, we found our icon
-				if (std::strcmp(icon["name"].get<std::string>().c_str(), name.m_pData) == 0)
-				{
-					// Update the icon position
-					POINT p = {};
-					p.x = icon["location"][0];
-					p.y = icon["location"][1];
+				// Saved icons without a file never show up
+				expected = std::min(saved_count, m_backend.list_files(m_backend.get_desktop_path()).size());
+			}
 
-					PCITEMID_CHILD child_item[1] = { item };
-					desktop_view->SelectAndPositionItems(1, child_item, &p, SVSI_POSITIONITEM);
+			const size_t count = m_backend.get_item_count();
+			if (count != shown)
+			{
+				DS_TRACE_SCOPE("position new icons");
+				shown = count;
 
-					// Remove this icon so we don't iterate over it again
-					icon_info["icons"].erase(j);
-					break;
+				// Files only arrive while loading, so after the first pass only the new items are enumerated
+				const auto items = enumerated == 0 ? m_backend.get_icons() : m_backend.get_new_icons();
+				std::vector<IconPlacement> placements = {};
+				for (size_t i = 0; i < items.size(); ++i)
+				{
+					DS_TRACE_SCOPE_DETAIL("place icon", items[i].name);
+
+					IconPlacement placement = {};
+					placement.item = enumerated + i;
+					if (index.take(items[i].name, placement.point))
+					{
+						placements.push_back(placement);
+						--unplaced;
+					}
 				}
+				enumerated += items.size();
+
+				m_backend.set_icon_positions(placements);
 			}
-			++i;
+
+			if (moved && (shown >= expected || std::chrono::steady_clock::now() >= deadline))
+				break;
+
+			// Check on the moves every so often even if nothing shows up
+			m_backend.wait_for_items([&](size_t c) { return c != shown; }, pipeline_step);
 		}
 
-		// Force the desktop to update
-		// SHChangeNotify(SHCNE_ASSOCCHANGED, SHCNF_FLUSH, NULL, NULL);
+		// Enable alignment to grid
+		m_backend.set_grid_alignment(true);
 
-		// Force the desktop to update
-		// SendMessage(GetDesktopWindow(), WM_KEYDOWN, VK_F5, 0);
+		// Rethrow anything the moves threw
+		MoveReport report = moves.get();
+		if (!moved) m_backend.refresh();
+		return report;
+	}
 
-		// TODO: Show the icons
+	SavePlan SavedDesktop::plan_layout(const std::vector<DesktopIcon>& icons, SwitchJournal& journal)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::plan_layout");
 
-		// Enable alignment to grid
-		desktop_view->SetCurrentFolderFlags(FWF_SNAPTOGRID, FWF_SNAPTOGRID);
+		SavePlan plan = {};
+		plan.icons = icons;
+
+		// Compare the desktop against the last save
+		const Manifest manifest = Manifest::scan(m_backend, m_backend.get_desktop_path(), icons);
+		const ManifestDiff diff = manifest.diff(Manifest::read(get_manifest_path()));
+
+		// Only rewrite what changed
+		if (diff.layout_changed)
+		{
+			plan.layout = make_layout(icons);
+			plan.binary_layout = LayoutFile::encode(icons);
+			journal.log_write(get_layout_path(), plan.layout);
+			journal.log_write(get_binary_layout_path(), plan.binary_layout, true);
+		}
+
+		if (!diff.empty())
+		{
+			plan.manifest = manifest.dump();
+			journal.log_write(get_manifest_path(), plan.manifest);
+		}
+
+		return plan;
 	}
 
-	SaveData::SaveData(const std::string& path) : m_path(path), m_desktops({}), m_active_desktop("")
+	void SavedDesktop::save_layout(const SavePlan& plan, CommitGroup& commit)
 	{
-		// Read the saved data
-		std::ifstream stream(path + "\\saves.json");
-		json j = {};
-		j << stream;
+		DS_TRACE_SCOPE("SavedDesktop::save_layout");
 
-		// Load every desktop
-		for (const auto& desktop : j["saves"])
+		// The binary layout goes second so it is never older than the locations file it came from
+		if (!plan.layout.empty())
 		{
-			const std::string save_name = desktop.get<std::string>();
-			m_desktops.push_back(SavedDesktop(save_name, path + "\\saves\\" + save_name));
+			commit.write_file(get_layout_path(), plan.layout);
+			commit.write_file(get_binary_layout_path(), plan.binary_layout);
 		}
 
-		// Get the active desktop
-		m_active_desktop = j["active_desktop"].get<std::string>();
+		if (!plan.manifest.empty())
+			commit.write_file(get_manifest_path(), plan.manifest);
 	}
 
-	void SaveData::save()
+	void SavedDesktop::load_layout()
 	{
-		// Update the saves file
-		json save_data = {};
+		DS_TRACE_SCOPE("SavedDesktop::load_layout");
 
-		// Add saves
+		apply_layout(read_layout());
+	}
+
+	std::string SavedDesktop::make_layout(const std::vector<DesktopIcon>& icons)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::make_layout");
+
+		return write_locations_json(icons);
+	}
+
+	LayoutFile SavedDesktop::read_layout() const
+	{
+		DS_TRACE_SCOPE("SavedDesktop::read_layout");
+
+		// The binary layout is only older than the locations file if that was edited by hand
+		FileInfo text_info = {};
+		FileInfo binary_info = {};
+		const bool has_text = m_backend.get_file_info(get_layout_path(), text_info);
+		if (m_backend.get_file_info(get_binary_layout_path(), binary_info) && (!has_text || binary_info.modified >= text_info.modified))
+		{
+			try
+			{ return LayoutFile::map(get_binary_layout_path()); }
+			catch (...)
+			{}
+		}
+
+		// A save that was never written has no icons
+		if (!has_text)
+			return LayoutFile::from_buffer(LayoutFile::encode({}));
+
+		// Fall back to the locations file
+		std::ifstream stream(get_layout_path());
+		std::stringstream text = {};
+		text << stream.rdbuf();
+
+		// A damaged layout only loses icon positions, which isn't worth aborting a switch over
+		try
+		{ return LayoutFile::from_buffer(LayoutFile::from_json(text.str())); }
+		catch (...)
+		{ return LayoutFile::from_buffer(LayoutFile::encode({})); }
+	}
+
+	void SavedDesktop::apply_layout(const LayoutFile& layout)
+	{
+		DS_TRACE_SCOPE("SavedDesktop::apply_layout");
+
+		// Repaint once at the end instead of after every icon
+		QuietRestore quiet(m_backend);
+
+		// Index the saved icons by name
+		LayoutIndex index(layout);
+
+		// Disable alignment to grid
+		m_backend.set_grid_alignment(false);
+
+		// Work out where every icon goes
+		const auto items = m_backend.get_icons();
+		std::vector<IconPlacement> placements = {};
+		placements.reserve(items.size());
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			DS_TRACE_SCOPE_DETAIL("place icon", items[i].name);
+
+			// Each saved icon is only used once
+			IconPlacement placement = {};
+			placement.item = i;
+			if (index.take(items[i].name, placement.point))
+				placements.push_back(placement);
+		}
+
+		// Move the icons back
+		m_backend.set_icon_positions(placements);
+
+		// Enable alignment to grid
+		m_backend.set_grid_alignment(true);
+	}
+
+	SavedDesktop* DesktopCatalog::find(const NameRef& name) noexcept
+	{
+		if (m_slots.empty()) return nullptr;
+
+		const size_t slot = find_slot(name);
+		return m_slots[slot] == no_desktop ? nullptr : &m_desktops[m_slots[slot]];
+	}
+
+	SavedDesktop& DesktopCatalog::add(SavedDesktop desktop)
+	{
+		m_desktops.push_back(std::move(desktop));
+
+		// Keep the table at most half full
+		if (m_slots.size() < m_desktops.size() * 2)
+			rehash();
+		else
+			m_slots[find_slot(make_name_ref(m_desktops.back().get_name()))] = m_desktops.size() - 1;
+
+		return m_desktops.back();
+	}
+
+	void DesktopCatalog::remove_last()
+	{
+		// Linear probing can't just empty a slot, but this only happens when a new desktop fails
+		m_desktops.pop_back();
+		rehash();
+	}
+
+	void DesktopCatalog::rehash()
+	{
+		size_t slot_count = 8;
+		while (slot_count < m_desktops.size() * 2)
+			slot_count *= 2;
+
+		m_slots.assign(slot_count, no_desktop);
 		for (size_t i = 0; i < m_desktops.size(); ++i)
-			save_data["saves"].push_back(m_desktops[i].get_name());
+			m_slots[find_slot(make_name_ref(m_desktops[i].get_name()))] = i;
+	}
 
-		// Add the new save name
-		save_data["active_desktop"] = m_active_desktop;
+	size_t DesktopCatalog::find_slot(const NameRef& name) const noexcept
+	{
+		const size_t mask = m_slots.size() - 1;
+		size_t slot = static_cast<size_t>(hash_name(name)) & mask;
+
+		// Linear probing
+		while (m_slots[slot] != no_desktop && !(make_name_ref(m_desktops[m_slots[slot]].get_name()) == name))
+			slot = (slot + 1) & mask;
+
+		return slot;
+	}
+
+	SaveData::SaveData(const std::string& path, DesktopBackend& backend, MoveEngine& move_engine) :
+		m_path(path),
+		m_journal_path(join_path(path, "journal.jsonl")),
+		m_backend(backend),
+		m_move_engine(move_engine),
+		m_desktops(),
+		m_active_desktop(""),
+		m_storage_mode(StorageMode::Move)
+	{
+		DS_TRACE_SCOPE("SaveData::SaveData");
+
+		// Finish whatever the last run was doing when it died
+		if (!SwitchJournal::recover(m_backend, m_journal_path))
+			throw std::runtime_error("Unable to finish the last operation. It will be retried on the next run.");
+
+		// Read the saved data
+		std::ifstream stream(join_path(path, "saves.json"), std::ios::binary);
+		std::stringstream text = {};
+		text << stream.rdbuf();
+
+		CatalogFile catalog = {};
+		if (!parse_catalog(text.str(), catalog))
+			throw std::runtime_error("Damaged saves file");
+
+		// Load every desktop
+		const std::string saves_path = join_path(path, "saves");
+		for (const auto& save_name : catalog.saves)
+			if (m_desktops.find(make_name_ref(save_name)) == nullptr)
+				m_desktops.add(SavedDesktop(save_name, join_path(saves_path, save_name), m_backend, m_move_engine));
+
+		m_active_desktop = std::move(catalog.active_desktop);
+		m_storage_mode = catalog.storage_mode;
+	}
+
+	void SaveData::save()
+	{
+		DS_TRACE_SCOPE("SaveData::save");
 
 		// Write new file
-		std::ofstream save_stream(m_path + "\\saves.json");
-		save_stream << save_data.dump(4);
-		save_stream.close();
+		CommitGroup commit(m_backend);
+		commit.write_file(join_path(m_path, "saves.json"), make_catalog(m_active_desktop, m_storage_mode));
+		commit.commit();
 	}
 
 	NewDesktopResult SaveData::new_desktop(const std::string& name)
 	{
-		// Make sure a desktop doesn't already exist with that name
-		for (const auto& desktop : m_desktops)
-			if (desktop.get_name() == name)
-				return NewDesktopResult::NameTaken;
+		DS_TRACE_SCOPE("SaveData::new_desktop");
+
+		// The name becomes a folder in the saves folder
+		if (!is_valid_save_name(name))
+			return NewDesktopResult::InvalidName;
 
-		// Save the active desktop
+		// Make sure a desktop doesn't already exist with that name, even one missing from the saves file
+		const std::string saves_path = join_path(m_path, "saves");
+		if (m_desktops.find(make_name_ref(name)) != nullptr ||
+			!m_backend.list_files(join_path(join_path(saves_path, name), "icons")).empty())
+			return NewDesktopResult::NameTaken;
+
+		// Make sure the active desktop exists
 		try
-		{
-			// Get the active desktop
-			SavedDesktop& active_desktop = get_active_desktop();
-			active_desktop.save();
-		}
+		{ get_active_desktop(); }
 		catch (...)
 		{ return NewDesktopResult::ActiveDesktopInvalid; }
 
+		const ViewStats stats = m_backend.get_view_stats();
+
 		// Add the new desktop
-		m_desktops.push_back(SavedDesktop(name, m_path + "\\saves\\" + name));
+		SavedDesktop& desktop = m_desktops.add(SavedDesktop(name, join_path(saves_path, name), m_backend, m_move_engine));
+		SavedDesktop& active_desktop = get_active_desktop();
+
+		// Log everything before touching anything
+		SwitchJournal journal(m_backend, m_journal_path);
+		CommitGroup commit(m_backend);
+		commit.touch_directory(saves_path);
+
+		SavePlan plan = {};
+		try
+		{
+			// Linked desktops only need their layout saved
+			if (m_storage_mode == StorageMode::Link)
+			{
+				active_desktop.save_layout(active_desktop.plan_layout(m_backend.get_icons(), journal), commit);
+				desktop.create_folders();
+				journal.log_link(m_backend.get_desktop_path(), desktop.get_icons_path());
+			}
+			else
+				plan = active_desktop.plan_save(journal);
+		}
+		catch (...)
+		{
+			m_desktops.remove_last();
+			return NewDesktopResult::ActiveDesktopInvalid;
+		}
+
+		log_catalog(journal, name, m_storage_mode);
+		journal.flush();
+
+		// Save the active desktop, or point the desktop at the new (empty) save
+		if (m_storage_mode == StorageMode::Link)
+			link_desktop(desktop, commit);
+		else
+		{
+			// Files left behind would end up in the new desktop, so put back what moved instead
+			const MoveReport report = active_desktop.save(plan, commit);
+			if (report.failed_count > 0)
+			{
+				journal.finish();
+				undo_moves(m_move_engine, plan.moves, report);
+				m_backend.refresh();
+				m_desktops.remove_last();
+				return NewDesktopResult::MoveFailed;
+			}
+		}
+
+		// Wait for the writes to hit the disk before the saves file points at them
+		commit.commit();
 
 		// Update the active desktop
 		m_active_desktop = name;
+		m_switch_stats = get_stats_since(stats, m_backend.get_view_stats());
 
 		// Save the state
 		save();
+		journal.finish();
 
 		return NewDesktopResult::Success;
 	}
 
+	CloneDesktopResult SaveData::clone_desktop(const std::string& name)
+	{
+		DS_TRACE_SCOPE("SaveData::clone_desktop");
+
+		// The name becomes a folder in the saves folder
+		if (!is_valid_save_name(name))
+			return CloneDesktopResult::InvalidName;
+
+		// Make sure a desktop doesn't already exist with that name
+		if (m_desktops.find(make_name_ref(name)) != nullptr)
+			return CloneDesktopResult::NameTaken;
+
+		// Make sure the active desktop exists
+		try
+		{ get_active_desktop(); }
+		catch (...)
+		{ return CloneDesktopResult::ActiveDesktopInvalid; }
+
+		// Linked desktops keep their files in the icons folder
+		const std::string source_path = m_storage_mode == StorageMode::Link ?
+			get_active_desktop().get_icons_path() :
+			m_backend.get_desktop_path();
+
+		const std::string saves_path = join_path(m_path, "saves");
+		const std::string save_path = join_path(saves_path, name);
+		const std::string icons_path = join_path(save_path, "icons");
+		const std::string clone_path = join_path(save_path, "icons.tmp");
+
+		// Files of a save missing from the saves file aren't ours to replace
+		if (!m_backend.list_files(icons_path).empty())
+			return CloneDesktopResult::NameTaken;
+
+		// Only the temporary folder and a save folder left empty are ours to clean up
+		const auto abandon = [&]()
+		{
+			m_backend.remove_tree(clone_path);
+			if (m_backend.list_files(icons_path).empty())
+				m_backend.remove_tree(icons_path);
+			if (m_backend.list_files(save_path).empty())
+				m_backend.remove_tree(save_path);
+		};
+
+		// Clone on the side, so a crash part way only leaves the temporary folder, which the next attempt clears
+		CloneStats stats = {};
+		m_backend.create_directory(save_path);
+		if (!m_backend.remove_tree(clone_path) || !m_backend.clone_file(source_path, clone_path, stats))
+		{
+			abandon();
+			return CloneDesktopResult::CloneFailed;
+		}
+
+		// Add the new desktop
+		SavedDesktop& desktop = m_desktops.add(SavedDesktop(name, save_path, m_backend, m_move_engine));
+
+		// Log everything before touching anything
+		SwitchJournal journal(m_backend, m_journal_path);
+		CommitGroup commit(m_backend);
+		commit.touch_directory(saves_path);
+		commit.touch_directory(save_path);
+
+		SavePlan plan = {};
+		try
+		{ plan = desktop.plan_layout(m_backend.get_icons(), journal); }
+		catch (...)
+		{
+			m_desktops.remove_last();
+			abandon();
+			return CloneDesktopResult::ActiveDesktopInvalid;
+		}
+
+		journal.log_rename(clone_path, icons_path, clone_path);
+		log_catalog(journal, m_active_desktop, m_storage_mode);
+		journal.flush();
+
+		// Put the clone in place, replacing the empty icons folder an earlier attempt may have left
+		if (!m_backend.replace_file(clone_path, icons_path))
+		{
+			journal.finish();
+			m_desktops.remove_last();
+			abandon();
+			return CloneDesktopResult::CloneFailed;
+		}
+
+		// Wait for the clone and its layout to hit the disk before the saves file points at them
+		desktop.save_layout(plan, commit);
+		commit.commit();
+		m_clone_stats = stats;
+
+		// Save the state
+		save();
+		journal.finish();
+
+		return CloneDesktopResult::Success;
+	}
+
 	LoadDesktopResult SaveData::load_desktop(const std::string& name)
 	{
+		DS_TRACE_SCOPE("SaveData::load_desktop");
+
 		// Get the desktop we want to load
 		SavedDesktop* desktop = nullptr;
 		try
@@ -338,25 +691,370 @@ namespace ds
 		if(name == m_active_desktop)
 		{ return LoadDesktopResult::CantLoadActiveDesktop; }
 
-		// Save the active desktop
+		// Get the active desktop
+		SavedDesktop* active_desktop = nullptr;
 		try
+		{ active_desktop = &get_active_desktop(); }
+		catch (...)
+		{ return LoadDesktopResult::ActiveDesktopInvalid; }
+
+		const ViewStats stats = m_backend.get_view_stats();
+
+		// Everything up to the saves file is logged first and made durable together
+		SwitchJournal journal(m_backend, m_journal_path);
+		CommitGroup commit(m_backend);
+
+		// Linked desktops only flip the link
+		if (m_storage_mode == StorageMode::Link)
 		{
-			// Get the active desktop
-			SavedDesktop& active_desktop = get_active_desktop();
-			active_desktop.save();
+			// Save the layout of the active desktop
+			try
+			{ active_desktop->save_layout(active_desktop->plan_layout(m_backend.get_icons(), journal), commit); }
+			catch (...)
+			{ return LoadDesktopResult::ActiveDesktopInvalid; }
+
+			desktop->create_folders();
+			journal.log_link(m_backend.get_desktop_path(), desktop->get_icons_path());
+			log_catalog(journal, name, m_storage_mode);
+			journal.flush();
+
+			// Show the new desktop
+			QuietRestore quiet(m_backend);
+			link_desktop(*desktop, commit);
+			desktop->load_layout();
 		}
-		catch (...)
-		{ return LoadDesktopResult::ActiveDesktopInvalid;}
+		// Swap whole folders when possible, otherwise move file by file
+		else if (!swap_desktops(*active_desktop, *desktop, journal, commit))
+		{
+			// Work out every move up front
+			SavePlan save_plan = {};
+			try
+			{ save_plan = active_desktop->plan_save(journal); }
+			catch (...)
+			{ return LoadDesktopResult::ActiveDesktopInvalid; }
+
+			LoadPlan load_plan = desktop->plan_load(journal);
+			log_catalog(journal, name, m_storage_mode);
+			journal.flush();
+
+			// Move the active desktop out of the way
+			MoveReport saved = {};
+			try
+			{ saved = active_desktop->move_out(save_plan, commit); }
+			catch (...)
+			{
+				// The switch is logged, so it has to be finished rather than abandoned
+				if (!finish_from_journal())
+					return LoadDesktopResult::Interrupted;
 
-		// Load the desktop
-		desktop->load();
+				m_switch_stats = get_stats_since(stats, m_backend.get_view_stats());
+				return LoadDesktopResult::Success;
+			}
+
+			// Files left behind would be mixed into the new desktop, so put back what moved instead. The journal
+			// goes first, since a file that won't move would keep recovery from ever finishing the switch.
+			if (saved.failed_count > 0)
+			{
+				journal.finish();
+				undo_moves(m_move_engine, save_plan.moves, saved);
+				m_backend.refresh();
+				return LoadDesktopResult::MoveFailed;
+			}
+
+			// Load the desktop, writing the layout of the old one while the files move
+			const MoveReport loaded = desktop->load(load_plan, commit, [&] { active_desktop->save_layout(save_plan, commit); });
+			if (loaded.failed_count > 0)
+			{
+				journal.finish();
+				undo_moves(m_move_engine, load_plan.moves, loaded);
+				undo_moves(m_move_engine, save_plan.moves, saved);
+				m_backend.refresh();
+				return LoadDesktopResult::MoveFailed;
+			}
+		}
+
+		// Wait for the writes to hit the disk before the saves file points at them
+		commit.commit();
 
 		// Update the active desktop
 		m_active_desktop = name;
+		m_switch_stats = get_stats_since(stats, m_backend.get_view_stats());
 
 		// Save the state
 		save();
+		journal.finish();
 
 		return LoadDesktopResult::Success;
 	}
+
+	bool SaveData::swap_desktops(SavedDesktop& active, SavedDesktop& desktop, SwitchJournal& journal, CommitGroup& commit)
+	{
+		DS_TRACE_SCOPE("SaveData::swap_desktops");
+
+		const std::string desktop_path = m_backend.get_desktop_path();
+		const std::string old_icons_path = active.get_icons_path();
+		const std::string new_icons_path = desktop.get_icons_path();
+
+		// Don't plan or log anything the backend can't carry out
+		if (!m_backend.supports_exchange())
+			return false;
+
+		// Renames only stay cheap on one filesystem
+		desktop.create_folders();
+		if (!m_backend.same_filesystem(desktop_path, new_icons_path))
+			return false;
+
+		// The outgoing icons folder gets replaced, so it can't hold anything
+		active.create_folders();
+		if (!m_backend.list_files(old_icons_path).empty())
+			return false;
+
+		// Remember where everything was
+		const SavePlan plan = active.plan_layout(m_backend.get_icons(), journal);
+
+		// Log the swap
+		journal.log_exchange(desktop_path, new_icons_path);
+		journal.log_rename(new_icons_path, old_icons_path, desktop_path);
+		journal.log_directory(new_icons_path);
+		log_catalog(journal, desktop.get_name(), m_storage_mode);
+		journal.flush();
+
+		// The desktop now holds the new files, and the new icons folder holds the old desktop
+		if (!m_backend.exchange_directories(desktop_path, new_icons_path))
+		{
+			journal.finish();
+			return false;
+		}
+
+		// Hand the old desktop over to the active save, in place of its empty icons folder
+		if (!m_backend.replace_file(new_icons_path, old_icons_path))
+		{
+			m_backend.exchange_directories(desktop_path, new_icons_path);
+			journal.finish();
+			return false;
+		}
+		m_backend.create_directory(new_icons_path);
+		commit.touch_directory(get_parent_path(desktop_path));
+		commit.touch_directory(get_parent_path(old_icons_path));
+		commit.touch_directory(get_parent_path(new_icons_path));
+
+		// Save the layout of the old desktop
+		active.save_layout(plan, commit);
+
+		// Force the desktop to update, repainting once the icons are back in place
+		QuietRestore quiet(m_backend);
+		m_backend.refresh();
+
+		// Put the icons back where they were
+		desktop.load_layout();
+
+		return true;
+	}
+
+	SetStorageModeResult SaveData::set_storage_mode(StorageMode mode)
+	{
+		DS_TRACE_SCOPE("SaveData::set_storage_mode");
+
+		if (mode == m_storage_mode)
+			return SetStorageModeResult::Success;
+
+		// Get the active desktop
+		SavedDesktop* active_desktop = nullptr;
+		try
+		{ active_desktop = &get_active_desktop(); }
+		catch (...)
+		{ return SetStorageModeResult::ActiveDesktopInvalid; }
+
+		const ViewStats stats = m_backend.get_view_stats();
+		const std::string desktop_path = m_backend.get_desktop_path();
+		SwitchJournal journal(m_backend, m_journal_path);
+		CommitGroup commit(m_backend);
+
+		if (mode == StorageMode::Link)
+		{
+			// Empty the desktop into the active save
+			SavePlan plan = {};
+			try
+			{ plan = active_desktop->plan_save(journal); }
+			catch (...)
+			{ return SetStorageModeResult::ActiveDesktopInvalid; }
+
+			journal.log_link(desktop_path, active_desktop->get_icons_path());
+			log_catalog(journal, m_active_desktop, mode);
+			journal.flush();
+
+			// Replace the (now empty) desktop folder with a link
+			const MoveReport report = active_desktop->save(plan, commit);
+			commit.commit();
+			if (report.failed_count > 0 || !m_backend.set_link(desktop_path, active_desktop->get_icons_path()))
+			{
+				// Put everything back the way it was
+				journal.finish();
+				LoadPlan undo = active_desktop->plan_load(journal);
+				log_catalog(journal, m_active_desktop, m_storage_mode);
+				journal.flush();
+
+				active_desktop->load(undo, commit);
+				commit.commit();
+				journal.finish();
+				return SetStorageModeResult::Unsupported;
+			}
+			commit.touch_directory(get_parent_path(desktop_path));
+
+			QuietRestore quiet(m_backend);
+			m_backend.refresh();
+			active_desktop->load_layout();
+		}
+		else
+		{
+			// Save the layout before the link goes away
+			try
+			{ active_desktop->save_layout(active_desktop->plan_layout(m_backend.get_icons(), journal), commit); }
+			catch (...)
+			{ return SetStorageModeResult::ActiveDesktopInvalid; }
+
+			// The load below reads the layout back
+			commit.commit();
+
+			// Bring back a real desktop folder and move the files into it
+			journal.log_unlink(desktop_path);
+			journal.log_directory(desktop_path);
+			LoadPlan plan = active_desktop->plan_load(journal);
+			log_catalog(journal, m_active_desktop, mode);
+			journal.flush();
+
+			if (!m_backend.remove_link(desktop_path) || !m_backend.create_directory(desktop_path))
+			{
+				journal.finish();
+				return SetStorageModeResult::Unsupported;
+			}
+			commit.touch_directory(get_parent_path(desktop_path));
+
+			active_desktop->load(plan, commit);
+		}
+
+		// Wait for the writes to hit the disk before the saves file points at them
+		commit.commit();
+
+		// Update the storage mode
+		m_storage_mode = mode;
+		m_switch_stats = get_stats_since(stats, m_backend.get_view_stats());
+
+		// Save the state
+		save();
+		journal.finish();
+
+		return SetStorageModeResult::Success;
+	}
+
+	bool SaveData::read_catalog(const std::string& path, CatalogFile& catalog)
+	{
+		DS_TRACE_SCOPE("SaveData::read_catalog");
+
+		// A journal means the catalog may not be the one the last operation ended with
+		if (std::ifstream(join_path(path, "journal.jsonl")))
+			return false;
+
+		std::ifstream stream(join_path(path, "saves.json"), std::ios::binary);
+		if (!stream) return false;
+
+		std::stringstream text = {};
+		text << stream.rdbuf();
+		return parse_catalog(text.str(), catalog);
+	}
+
+	bool SaveData::parse_catalog(const std::string& text, CatalogFile& catalog)
+	{
+		JsonReader reader(text.data(), text.size());
+		if (reader.next() != JsonEvent::BeginObject) return false;
+
+		bool has_active = false;
+		for (JsonEvent event = reader.next(); event != JsonEvent::EndObject; event = reader.next())
+		{
+			if (event != JsonEvent::Key) return false;
+
+			if (reader.string_equals("saves"))
+			{
+				if (reader.next() != JsonEvent::BeginArray) return false;
+				for (event = reader.next(); event != JsonEvent::EndArray; event = reader.next())
+				{
+					if (event != JsonEvent::String) return false;
+					const NameRef name = reader.get_string();
+					catalog.saves.emplace_back(name.data, name.size);
+				}
+			}
+			else if (reader.string_equals("active_desktop"))
+			{
+				if (reader.next() != JsonEvent::String) return false;
+				const NameRef name = reader.get_string();
+				catalog.active_desktop.assign(name.data, name.size);
+				has_active = true;
+			}
+			else if (reader.string_equals("storage_mode"))
+			{
+				if (reader.next() != JsonEvent::String) return false;
+				catalog.storage_mode = reader.string_equals("link") ? StorageMode::Link : StorageMode::Move;
+			}
+			else if (!reader.skip(reader.next()))
+				return false;
+		}
+
+		return has_active && reader.next() == JsonEvent::End;
+	}
+
+	std::string SaveData::make_catalog(const std::string& active_desktop, StorageMode mode) const
+	{
+		DS_TRACE_SCOPE("SaveData::make_catalog");
+
+		// Update the saves file
+		JsonArena arena;
+		arena_json save_data = {};
+
+		// Add saves
+		for (size_t i = 0; i < m_desktops.get_count(); ++i)
+			save_data["saves"].push_back(m_desktops.get(i).get_name());
+
+		// Add the new save name
+		save_data["active_desktop"] = active_desktop;
+
+		// Add the storage mode
+		save_data["storage_mode"] = mode == StorageMode::Link ? "link" : "move";
+
+		return save_data.dump(4);
+	}
+
+	bool SaveData::finish_from_journal()
+	{
+		DS_TRACE_SCOPE("SaveData::finish_from_journal");
+
+		if (!SwitchJournal::recover(m_backend, m_journal_path))
+			return false;
+
+		// The saves file is now the one the operation ended with
+		CatalogFile catalog = {};
+		if (!read_catalog(m_path, catalog))
+			return false;
+
+		m_active_desktop = catalog.active_desktop;
+		m_storage_mode = catalog.storage_mode;
+		return true;
+	}
+
+	void SaveData::log_catalog(SwitchJournal& journal, const std::string& active_desktop, StorageMode mode) const
+	{
+		journal.log_write(join_path(m_path, "saves.json"), make_catalog(active_desktop, mode));
+	}
+
+	void SaveData::link_desktop(SavedDesktop& desktop, CommitGroup& commit)
+	{
+		DS_TRACE_SCOPE("SaveData::link_desktop");
+
+		const std::string desktop_path = m_backend.get_desktop_path();
+		if (!m_backend.set_link(desktop_path, desktop.get_icons_path()))
+			throw std::runtime_error("Unable to link the desktop to the save.");
+		commit.touch_directory(get_parent_path(desktop_path));
+
+		// Force the desktop to update
+		m_backend.refresh();
+	}
 }
\ No newline at end of file
@@ -7,14 +7,55 @@
  */
 
 /** Includes. */
+#include <functional>
 #include <string>
+#include <vector>
 #include "json.hpp"
+#include "desktop_backend.hpp"
+#include "commit_group.hpp"
+#include "layout_file.hpp"
+#include "manifest.hpp"
+#include "move_engine.hpp"
+#include "switch_journal.hpp"
 
 /** For convenience. */
 using json = nlohmann::json;
 
 namespace ds
 {
+	/**
+	 * Work needed to save the desktop.
+	 */
+	struct SavePlan
+	{
+		/** Icons on the desktop. */
+		std::vector<DesktopIcon> icons = {};
+
+		/** Contents of the locations file, or empty if the layout didn't change. */
+		std::string layout = "";
+
+		/** Contents of the binary layout file, or empty if the layout didn't change. */
+		std::string binary_layout = "";
+
+		/** Contents of the manifest file, or empty if nothing changed. */
+		std::string manifest = "";
+
+		/** Files to move into the save. */
+		std::vector<FileMove> moves = {};
+	};
+
+	/**
+	 * Work needed to load a saved desktop.
+	 */
+	struct LoadPlan
+	{
+		/** Saved layout. */
+		LayoutFile layout = {};
+
+		/** Files to move onto the desktop. */
+		std::vector<FileMove> moves = {};
+	};
+
 	/**
 	 * Saved desktop.
 	 */
@@ -26,32 +67,213 @@ namespace ds
 		 * Constructor.
 		 * @param Save name.
 		 * @param Path to save folder.
+		 * @param Desktop backend.
+		 * @param Move engine.
 		 */
-		SavedDesktop(const std::string& name, const std::string& path);
+		SavedDesktop(const std::string& name, const std::string& path, DesktopBackend& backend, MoveEngine& move_engine);
+
+		/**
+		 * Make sure the save and icons folders exist.
+		 * @note Nothing touches the disk until a desktop is saved or loaded, so listing saves stays cheap.
+		 */
+		void create_folders();
 
 		/**
 		 * Get the save name.
 		 * @return Save name.
 		 */
-		inline std::string get_name() const noexcept;
+		inline const std::string& get_name() const noexcept;
+
+		/**
+		 * Get the folder the desktop files are kept in while the save isn't active.
+		 * @return Icons folder path.
+		 */
+		inline std::string get_icons_path() const;
+
+		/**
+		 * Get the path to the locations file.
+		 * @return Locations file path.
+		 */
+		inline std::string get_layout_path() const;
+
+		/**
+		 * Get the path to the manifest file.
+		 * @return Manifest file path.
+		 */
+		inline std::string get_manifest_path() const;
+
+		/**
+		 * Get the path to the binary layout file.
+		 * @return Binary layout file path.
+		 */
+		inline std::string get_binary_layout_path() const;
+
+		/**
+		 * Work out what saving the current desktop involves and log it.
+		 * @param Journal to log to.
+		 * @return Save plan.
+		 */
+		SavePlan plan_save(SwitchJournal& journal);
 
 		/**
 		 * Save the current desktop.
+		 * @param Save plan, after the journal has been flushed.
+		 * @param Commit group the writes belong to.
+		 * @return Report of the moves.
 		 */
-		void save();
+		MoveReport save(const SavePlan& plan, CommitGroup& commit);
+
+		/**
+		 * Move the desktop files into the save without waiting for the view or saving the layout.
+		 * @param Save plan, after the journal has been flushed.
+		 * @param Commit group the moves belong to.
+		 * @return Report of the moves.
+		 */
+		MoveReport move_out(const SavePlan& plan, CommitGroup& commit);
 
 		/**
-		 * Load the current desktop.
+		 * Work out what loading this desktop involves and log it.
+		 * @param Journal to log to.
+		 * @return Load plan.
 		 */
-		void load();
+		LoadPlan plan_load(SwitchJournal& journal);
+
+		/**
+		 * Load this desktop.
+		 * Files are moved in the background and icons are positioned as soon as they show up.
+		 * @param Load plan, after the journal has been flushed.
+		 * @param Commit group the writes belong to.
+		 * @param Work to do while the files move.
+		 * @return Report of the moves.
+		 */
+		MoveReport load(LoadPlan& plan, CommitGroup& commit, const std::function<void()>& overlap = nullptr);
+
+		/**
+		 * Work out which icon positions changed since the last save and log them, without moving any files.
+		 * @param Desktop icons.
+		 * @param Journal to log to.
+		 * @return Save plan with no moves.
+		 */
+		SavePlan plan_layout(const std::vector<DesktopIcon>& icons, SwitchJournal& journal);
+
+		/**
+		 * Stage the files a save plan changes.
+		 * @param Save plan, after the journal has been flushed.
+		 * @param Commit group the writes belong to.
+		 * @note Nothing is written if the desktop didn't change.
+		 */
+		void save_layout(const SavePlan& plan, CommitGroup& commit);
+
+		/**
+		 * Restore icon positions once the files are on the desktop.
+		 */
+		void load_layout();
+
+		/**
+		 * Serialize icon positions.
+		 * @param Desktop icons.
+		 * @return Contents of a locations file.
+		 */
+		static std::string make_layout(const std::vector<DesktopIcon>& icons);
 
 	private:
 
+		/**
+		 * Read the saved layout, preferring the binary layout file.
+		 * @return Saved layout.
+		 */
+		LayoutFile read_layout() const;
+
+		/**
+		 * Position the desktop icons.
+		 * @param Saved layout.
+		 */
+		void apply_layout(const LayoutFile& layout);
+
 		/** Save name. */
 		const std::string m_name;
 
 		/** Path to save folder. */
 		const std::string m_path;
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+
+		/** Move engine. */
+		MoveEngine& m_move_engine;
+
+		/** If the folders are known to exist. */
+		bool m_folders_created = false;
+	};
+
+	/**
+	 * Saved desktops, indexed by name.
+	 */
+	class DesktopCatalog
+	{
+	public:
+
+		DesktopCatalog() = default;
+
+		/**
+		 * Get the number of desktops.
+		 * @return Number of desktops.
+		 */
+		inline size_t get_count() const noexcept;
+
+		/**
+		 * Get a desktop by index, in the order they were added.
+		 * @param Index.
+		 * @return Desktop.
+		 */
+		inline SavedDesktop& get(size_t i) noexcept;
+
+		/**
+		 * Get a desktop by index, in the order they were added.
+		 * @param Index.
+		 * @return Desktop.
+		 */
+		inline const SavedDesktop& get(size_t i) const noexcept;
+
+		/**
+		 * Find a desktop by name without allocating.
+		 * @param Name.
+		 * @return Desktop, or nullptr if there is none by that name.
+		 */
+		SavedDesktop* find(const NameRef& name) noexcept;
+
+		/**
+		 * Add a desktop.
+		 * @param Desktop, whose name must not be taken.
+		 * @return Added desktop.
+		 * @note References to other desktops are invalidated.
+		 */
+		SavedDesktop& add(SavedDesktop desktop);
+
+		/**
+		 * Remove the most recently added desktop.
+		 */
+		void remove_last();
+
+	private:
+
+		/**
+		 * Rebuild the hash table to fit the desktops.
+		 */
+		void rehash();
+
+		/**
+		 * Find the slot of a name.
+		 * @param Name.
+		 * @return Slot holding the name, or the empty slot it would go in.
+		 */
+		size_t find_slot(const NameRef& name) const noexcept;
+
+		/** Desktops, in the order they were added. */
+		std::vector<SavedDesktop> m_desktops = {};
+
+		/** Index of the desktop with the slot's name, or empty. Open addressing, a power of two in size. */
+		std::vector<size_t> m_slots = {};
 	};
 
 	/**
@@ -61,7 +283,21 @@ namespace ds
 	{
 		Success = 0,
 		NameTaken = 1,
-		ActiveDesktopInvalid = 2
+		ActiveDesktopInvalid = 2,
+		MoveFailed = 3,
+		InvalidName = 4
+	};
+
+	/**
+	 * Clone desktop return codes.
+	 */
+	enum class CloneDesktopResult
+	{
+		Success = 0,
+		NameTaken = 1,
+		ActiveDesktopInvalid = 2,
+		CloneFailed = 3,
+		InvalidName = 4
 	};
 
 	/**
@@ -72,7 +308,46 @@ namespace ds
 		Success = 0,
 		InvalidSaveName = 1,
 		ActiveDesktopInvalid = 2,
-		CantLoadActiveDesktop = 3
+		CantLoadActiveDesktop = 3,
+		Interrupted = 4,
+		MoveFailed = 5
+	};
+
+	/**
+	 * How saved desktops are stored.
+	 */
+	enum class StorageMode
+	{
+		/** Files are moved in and out of the desktop folder. */
+		Move = 0,
+
+		/** The desktop folder is a link to the icons folder of the active desktop. */
+		Link = 1
+	};
+
+	/**
+	 * Contents of the saves file.
+	 */
+	struct CatalogFile
+	{
+		/** Save names, in order. */
+		std::vector<std::string> saves = {};
+
+		/** Name of the active desktop. */
+		std::string active_desktop = "";
+
+		/** Storage mode. */
+		StorageMode storage_mode = StorageMode::Move;
+	};
+
+	/**
+	 * Set storage mode return codes.
+	 */
+	enum class SetStorageModeResult
+	{
+		Success = 0,
+		Unsupported = 1,
+		ActiveDesktopInvalid = 2
 	};
 
 	/**
@@ -85,11 +360,22 @@ namespace ds
 		/**
 		 * Constructor.
 		 * @param Path to Desktop-Saver folder.
+		 * @param Desktop backend.
+		 * @param Move engine.
+		 */
+		SaveData(const std::string& path, DesktopBackend& backend, MoveEngine& move_engine);
+
+		/**
+		 * Read the saves file without a backend, for commands that only need the catalog.
+		 * @param Path to Desktop-Saver folder.
+		 * @param Saves file contents.
+		 * @return If the file was read. False if it is missing or damaged, or an operation still has to be recovered.
 		 */
-		SaveData(const std::string& path);
+		static bool read_catalog(const std::string& path, CatalogFile& catalog);
 
 		/**
 		 * Save the current state.
+		 * @note This is the commit point of every operation, so it is written last and made durable.
 		 */
 		void save();
 
@@ -126,6 +412,16 @@ namespace ds
 		 */
 		NewDesktopResult new_desktop(const std::string& name);
 
+		/**
+		 * Create a new desktop with a copy of the files and layout of the active desktop.
+		 * The active desktop stays active and nothing on it is touched.
+		 * @param Name.
+		 * @return Result of cloning the desktop.
+		 * @note Files are reflinked or hard linked where the filesystem allows, so cloning takes no
+		 * time or space until the desktops diverge. Hard linked files share edits made in place.
+		 */
+		CloneDesktopResult clone_desktop(const std::string& name);
+
 		/**
 		 * Load a desktop.
 		 * @param Desktop name.
@@ -133,16 +429,107 @@ namespace ds
 		 */
 		LoadDesktopResult load_desktop(const std::string& name);
 
+		/**
+		 * Get the storage mode.
+		 * @return Storage mode.
+		 */
+		inline StorageMode get_storage_mode() const noexcept;
+
+		/**
+		 * Change the storage mode, converting the active desktop.
+		 * @param Storage mode.
+		 * @return Result of changing the storage mode.
+		 */
+		SetStorageModeResult set_storage_mode(StorageMode mode);
+
+		/**
+		 * Get how much work the desktop view did during the last successful switch.
+		 * @return View statistics.
+		 */
+		inline const ViewStats& get_switch_stats() const noexcept;
+
+		/**
+		 * Get how the files of the last successful clone were duplicated.
+		 * @return Clone statistics.
+		 */
+		inline const CloneStats& get_clone_stats() const noexcept;
+
 	private:
 
+		/**
+		 * Parse the saves file.
+		 * @param Contents of the saves file.
+		 * @param Saves file contents.
+		 * @return If the file was valid.
+		 */
+		static bool parse_catalog(const std::string& text, CatalogFile& catalog);
+
+		/**
+		 * Serialize the saves file.
+		 * @param Name of the active desktop.
+		 * @param Storage mode.
+		 * @return Contents of the saves file.
+		 */
+		std::string make_catalog(const std::string& active_desktop, StorageMode mode) const;
+
+		/**
+		 * Log the saves file an operation ends with.
+		 * @param Journal to log to.
+		 * @param Name of the active desktop afterwards.
+		 * @param Storage mode afterwards.
+		 */
+		void log_catalog(SwitchJournal& journal, const std::string& active_desktop, StorageMode mode) const;
+
+		/**
+		 * Finish an operation from its journal after it failed part way.
+		 * @return If the operation was finished. If not, it is finished on the next run.
+		 */
+		bool finish_from_journal();
+
+		/**
+		 * Point the desktop link at a saved desktop.
+		 * @param Desktop.
+		 * @param Commit group the link belongs to.
+		 * @note The link must already be logged.
+		 */
+		void link_desktop(SavedDesktop& desktop, CommitGroup& commit);
+
+		/**
+		 * Switch desktops by swapping the desktop folder with the icons folder of the new desktop.
+		 * @param Active desktop.
+		 * @param Desktop to load.
+		 * @param Journal to log to.
+		 * @param Commit group the writes belong to.
+		 * @return If the desktops were swapped. If not, nothing has been moved and the journal is empty.
+		 */
+		bool swap_desktops(SavedDesktop& active, SavedDesktop& desktop, SwitchJournal& journal, CommitGroup& commit);
+
 		/** Path to Desktop-Saver folder. */
 		const std::string m_path;
 
+		/** Path to the journal of the operation in progress. */
+		const std::string m_journal_path;
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+
+		/** Move engine. */
+		MoveEngine& m_move_engine;
+
 		/** Saved desktops. */
-		std::vector<SavedDesktop> m_desktops;
+		DesktopCatalog m_desktops;
 
 		/** Name of the active desktop. */
 		std::string m_active_desktop;
+
+		/** How saved desktops are stored. */
+		StorageMode m_storage_mode;
+
+		/** Work the desktop view did during the last successful switch. */
+		ViewStats m_switch_stats = {};
+
+		/** How the files of the last successful clone were duplicated. */
+		CloneStats m_clone_stats = {};
 	};
 }
 
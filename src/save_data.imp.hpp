@@ -8,16 +8,66 @@
 
 namespace ds
 {
-	inline std::string SavedDesktop::get_name() const noexcept
+	inline const std::string& SavedDesktop::get_name() const noexcept
 	{
 		return m_name;
 	}
 
-	inline size_t SaveData::get_save_count() const
+	inline std::string SavedDesktop::get_icons_path() const
+	{
+		return join_path(m_path, "icons");
+	}
+
+	inline std::string SavedDesktop::get_layout_path() const
+	{
+		return join_path(m_path, "locations.json");
+	}
+
+	inline std::string SavedDesktop::get_manifest_path() const
+	{
+		return join_path(m_path, "manifest.json");
+	}
+
+	inline std::string SavedDesktop::get_binary_layout_path() const
+	{
+		return join_path(m_path, "locations.bin");
+	}
+
+	inline size_t DesktopCatalog::get_count() const noexcept
 	{
 		return m_desktops.size();
 	}
 
+	inline SavedDesktop& DesktopCatalog::get(size_t i) noexcept
+	{
+		return m_desktops[i];
+	}
+
+	inline const SavedDesktop& DesktopCatalog::get(size_t i) const noexcept
+	{
+		return m_desktops[i];
+	}
+
+	inline size_t SaveData::get_save_count() const
+	{
+		return m_desktops.get_count();
+	}
+
+	inline StorageMode SaveData::get_storage_mode() const noexcept
+	{
+		return m_storage_mode;
+	}
+
+	inline const ViewStats& SaveData::get_switch_stats() const noexcept
+	{
+		return m_switch_stats;
+	}
+
+	inline const CloneStats& SaveData::get_clone_stats() const noexcept
+	{
+		return m_clone_stats;
+	}
+
 	inline SavedDesktop& SaveData::get_active_desktop()
 	{
 		return get_save(m_active_desktop);
@@ -25,15 +75,14 @@ namespace ds
 
 	inline SavedDesktop& SaveData::get_save(size_t i)
 	{
-		return m_desktops[i];
+		return m_desktops.get(i);
 	}
 
 	inline SavedDesktop& SaveData::get_save(const std::string& name)
 	{
-		// Loop over every desktop and find one with a matching name
-		for (auto& desktop : m_desktops)
-			if (desktop.get_name() == name)
-				return desktop;
+		SavedDesktop* desktop = m_desktops.find(make_name_ref(name));
+		if (desktop != nullptr)
+			return *desktop;
 
 		throw std::runtime_error("Unable to find a desktop with the desired name.");
 	}
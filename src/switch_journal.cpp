@@ -0,0 +1,373 @@
+/**
+ * @file switch_journal.cpp
+ * @brief Switch journal source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "switch_journal.hpp"
+#include "commit_group.hpp"
+#include "trace.hpp"
+
+/** For convenience. */
+using json = nlohmann::json;
+
+namespace
+{
+	/**
+	 * Get the identifier of a file.
+	 * @param Desktop backend.
+	 * @param Path.
+	 * @return File identifier, or 0 if it doesn't exist.
+	 */
+	uint64_t get_file_id(ds::DesktopBackend& backend, const std::string& path)
+	{
+		ds::FileInfo info = {};
+		return backend.get_file_info(path, info) ? info.id : 0;
+	}
+
+	/**
+	 * Check if a logged change has a field of some type.
+	 * @param Logged change.
+	 * @param Field name.
+	 * @param Type check, such as json::is_string.
+	 * @return If the field is there and has the type.
+	 */
+	bool has_field(const json& op, const char* key, bool (json::*is_type)() const)
+	{
+		const auto field = op.find(key);
+		return field != op.end() && ((*field).*is_type)();
+	}
+
+	/**
+	 * Check if a logged change has every field its kind needs.
+	 * @param Logged change.
+	 * @return If the change can be replayed.
+	 */
+	bool is_valid_op(const json& op)
+	{
+		if (!op.is_object() || !has_field(op, "op", &json::is_string))
+			return false;
+
+		const std::string type = op.at("op");
+		if (type == "moves")
+		{
+			if (!has_field(op, "list", &json::is_array)) return false;
+			for (const auto& move : op.at("list"))
+				if (!move.is_array() || move.size() != 2 || !move.at(0).is_string() || !move.at(1).is_string())
+					return false;
+			return true;
+		}
+		if (type == "exchange")
+			return has_field(op, "a", &json::is_string) && has_field(op, "b", &json::is_string) && has_field(op, "id", &json::is_number_integer);
+		if (type == "rename")
+			return has_field(op, "from", &json::is_string) && has_field(op, "to", &json::is_string) && has_field(op, "id", &json::is_number_integer);
+		if (type == "directory")
+			return has_field(op, "path", &json::is_string);
+		if (type == "link")
+			return has_field(op, "link", &json::is_string) && has_field(op, "target", &json::is_string);
+		if (type == "unlink")
+			return has_field(op, "link", &json::is_string);
+		if (type == "write")
+		{
+			if (!has_field(op, "path", &json::is_string)) return false;
+			if (op.find("hex") == op.end()) return has_field(op, "contents", &json::is_string);
+			if (!has_field(op, "hex", &json::is_string)) return false;
+
+			const std::string hex = op.at("hex");
+			return hex.size() % 2 == 0 && hex.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Outcome of replaying a logged change.
+	 */
+	enum class ReplayResult
+	{
+		/** The change is in place. */
+		Done,
+
+		/** The change couldn't be made, so it has to be tried again. */
+		Failed,
+
+		/** The change could never have been made, so nothing from its record on was acted on. */
+		Impossible
+	};
+
+	/**
+	 * Replay a single logged change.
+	 * @param Desktop backend.
+	 * @param Commit group for file writes.
+	 * @param Logged change.
+	 * @return Replay result.
+	 */
+	ReplayResult replay(ds::DesktopBackend& backend, ds::CommitGroup& commit, const json& op)
+	{
+		const std::string type = op.at("op");
+
+		if (type == "moves")
+		{
+			for (const auto& move : op.at("list"))
+			{
+				const std::string from = move.at(0);
+				const std::string to = move.at(1);
+
+				// Only what didn't happen yet
+				if (backend.file_exists(from) && !backend.file_exists(to) && !backend.move_file(from, to))
+					return ReplayResult::Failed;
+
+				commit.touch_directory(ds::get_parent_path(from));
+				commit.touch_directory(ds::get_parent_path(to));
+			}
+		}
+		else if (type == "exchange")
+		{
+			const std::string a = op.at("a");
+			const std::string b = op.at("b");
+
+			// After the swap the first folder is the one that used to be the second. A swap the
+			// filesystem turns down never happened, and the switch was logged to start with it.
+			if (get_file_id(backend, a) != op.at("id").get<uint64_t>() && !backend.exchange_directories(a, b))
+				return backend.supports_exchange() ? ReplayResult::Failed : ReplayResult::Impossible;
+
+			commit.touch_directory(ds::get_parent_path(a));
+			commit.touch_directory(ds::get_parent_path(b));
+		}
+		else if (type == "rename")
+		{
+			const std::string from = op.at("from");
+			const std::string to = op.at("to");
+
+			// The destination is an empty folder that gets replaced
+			if (get_file_id(backend, from) == op.at("id").get<uint64_t>() && !backend.replace_file(from, to))
+				return ReplayResult::Failed;
+
+			commit.touch_directory(ds::get_parent_path(from));
+			commit.touch_directory(ds::get_parent_path(to));
+		}
+		else if (type == "directory")
+		{
+			const std::string path = op.at("path");
+			if (!backend.create_directory(path))
+				return ReplayResult::Failed;
+
+			commit.touch_directory(ds::get_parent_path(path));
+		}
+		else if (type == "link")
+		{
+			const std::string link = op.at("link");
+			if (!backend.set_link(link, op.at("target").get<std::string>()))
+				return ReplayResult::Failed;
+
+			commit.touch_directory(ds::get_parent_path(link));
+		}
+		else if (type == "unlink")
+		{
+			const std::string link = op.at("link");
+			// Already gone if the link was removed before the crash
+			if (backend.is_link(link) && !backend.remove_link(link))
+				return ReplayResult::Failed;
+
+			commit.touch_directory(ds::get_parent_path(link));
+		}
+		else if (type == "write")
+		{
+			if (op.find("hex") != op.end())
+			{
+				const std::string hex = op.at("hex");
+				std::string contents(hex.size() / 2, '\0');
+				for (size_t i = 0; i < contents.size(); ++i)
+					contents[i] = static_cast<char>(std::stoi(hex.substr(i * 2, 2), nullptr, 16));
+
+				commit.write_file(op.at("path").get<std::string>(), contents);
+			}
+			else commit.write_file(op.at("path").get<std::string>(), op.at("contents").get<std::string>());
+		}
+
+		return ReplayResult::Done;
+	}
+}
+
+namespace ds
+{
+	SwitchJournal::SwitchJournal(DesktopBackend& backend, const std::string& path) :
+		m_backend(backend),
+		m_path(path),
+		m_pending(json::array())
+	{
+
+	}
+
+	void SwitchJournal::log_moves(const std::vector<FileMove>& moves)
+	{
+		if (moves.empty()) return;
+
+		json list = json::array();
+		for (const auto& move : moves)
+			list.push_back({ move.from, move.to });
+
+		json op = {};
+		op["op"] = "moves";
+		op["list"] = std::move(list);
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_exchange(const std::string& a, const std::string& b)
+	{
+		json op = {};
+		op["op"] = "exchange";
+		op["a"] = a;
+		op["b"] = b;
+		op["id"] = get_file_id(m_backend, b);
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_rename(const std::string& from, const std::string& to, const std::string& current)
+	{
+		json op = {};
+		op["op"] = "rename";
+		op["from"] = from;
+		op["to"] = to;
+		op["id"] = get_file_id(m_backend, current);
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_directory(const std::string& path)
+	{
+		json op = {};
+		op["op"] = "directory";
+		op["path"] = path;
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_link(const std::string& link, const std::string& target)
+	{
+		json op = {};
+		op["op"] = "link";
+		op["link"] = link;
+		op["target"] = target;
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_unlink(const std::string& link)
+	{
+		json op = {};
+		op["op"] = "unlink";
+		op["link"] = link;
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::log_write(const std::string& path, const std::string& contents, bool binary)
+	{
+		json op = {};
+		op["op"] = "write";
+		op["path"] = path;
+
+		// JSON strings have to be valid UTF-8
+		if (binary)
+		{
+			static const char digits[] = "0123456789abcdef";
+			std::string hex(contents.size() * 2, '0');
+			for (size_t i = 0; i < contents.size(); ++i)
+			{
+				hex[i * 2] = digits[static_cast<unsigned char>(contents[i]) >> 4];
+				hex[i * 2 + 1] = digits[static_cast<unsigned char>(contents[i]) & 0xF];
+			}
+			op["hex"] = std::move(hex);
+		}
+		else op["contents"] = contents;
+
+		m_pending.push_back(std::move(op));
+	}
+
+	void SwitchJournal::flush()
+	{
+		DS_TRACE_SCOPE("SwitchJournal::flush");
+
+		if (m_pending.empty()) return;
+
+		// Starting over would lose the changes an earlier operation still has to finish
+		if (!m_started && std::ifstream(m_path))
+			throw std::runtime_error("The last operation is unfinished. It will be completed on the next run.");
+
+		// One line per flush, so a torn write only loses changes that never started
+		json record = {};
+		record["ops"] = std::move(m_pending);
+		m_pending = json::array();
+
+		std::ofstream stream(m_path, m_started ? std::ios::app : std::ios::trunc);
+		stream << record.dump() << '\n';
+		stream.close();
+		if (!stream) throw std::runtime_error("Unable to write the journal.");
+
+		m_backend.sync_file(m_path);
+
+		// The journal itself has to survive too
+		if (!m_started)
+			m_backend.sync_directory(get_parent_path(m_path));
+
+		m_started = true;
+	}
+
+	void SwitchJournal::finish()
+	{
+		m_pending = json::array();
+		if (!m_started) return;
+
+		std::remove(m_path.c_str());
+		m_started = false;
+	}
+
+	bool SwitchJournal::recover(DesktopBackend& backend, const std::string& path)
+	{
+		DS_TRACE_SCOPE("SwitchJournal::recover");
+
+		std::ifstream stream(path);
+		if (!stream) return true;
+
+		CommitGroup commit(backend);
+		for (std::string line; std::getline(stream, line); )
+		{
+			// A torn or damaged record was never acted on, since each one is written before anything in it happens
+			json record = {};
+			try
+			{ record = json::parse(line); }
+			catch (...)
+			{ break; }
+
+			if (!record.is_object() || !has_field(record, "ops", &json::is_array))
+				break;
+
+			bool valid = true;
+			for (const auto& op : record.at("ops"))
+				valid = valid && is_valid_op(op);
+			if (!valid) break;
+
+			// Stop at the first change that can't be made, so the saves file is never written ahead of
+			// the files it describes, and keep the journal to try again next time
+			ReplayResult result = ReplayResult::Done;
+			for (const auto& op : record.at("ops"))
+			{
+				result = replay(backend, commit, op);
+				if (result == ReplayResult::Failed)
+					return false;
+				if (result == ReplayResult::Impossible)
+					break;
+			}
+
+			if (result == ReplayResult::Impossible)
+				break;
+		}
+		stream.close();
+
+		commit.commit();
+		std::remove(path.c_str());
+
+		return true;
+	}
+}
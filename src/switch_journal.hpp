@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * @file switch_journal.hpp
+ * @brief Switch journal header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "desktop_backend.hpp"
+#include "move_engine.hpp"
+
+namespace ds
+{
+	/**
+	 * Write-ahead journal of the file system changes an operation is about to make.
+	 * Every change is logged before flush(), and nothing may be touched until flush() returns.
+	 * If the process dies before finish(), recover() completes the changes that didn't happen.
+	 * Replaying is idempotent, so changes that did happen are skipped.
+	 */
+	class SwitchJournal
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Desktop backend.
+		 * @param Path to the journal file.
+		 */
+		SwitchJournal(DesktopBackend& backend, const std::string& path);
+
+		/**
+		 * Log a batch of file moves.
+		 * @param Moves.
+		 * @note Replayed if the source still exists and the destination doesn't.
+		 */
+		void log_moves(const std::vector<FileMove>& moves);
+
+		/**
+		 * Log swapping two folders.
+		 * @param First folder.
+		 * @param Second folder.
+		 * @note Replayed unless the first folder already is the second one. If the filesystem can't exchange folders,
+		 * nothing from this record on is replayed, since the switch couldn't have got past the exchange.
+		 */
+		void log_exchange(const std::string& a, const std::string& b);
+
+		/**
+		 * Log renaming a folder over an empty folder.
+		 * @param Source folder.
+		 * @param Destination folder.
+		 * @param Path of the source folder at the time it will be renamed, which may differ now.
+		 * @note Replayed while the source is still the folder that was logged. The destination may be an empty folder, which is replaced.
+		 */
+		void log_rename(const std::string& from, const std::string& to, const std::string& current);
+
+		/**
+		 * Log creating a folder.
+		 * @param Folder path.
+		 */
+		void log_directory(const std::string& path);
+
+		/**
+		 * Log pointing a link at a folder.
+		 * @param Link path.
+		 * @param Target folder.
+		 */
+		void log_link(const std::string& link, const std::string& target);
+
+		/**
+		 * Log removing a link.
+		 * @param Link path.
+		 */
+		void log_unlink(const std::string& link);
+
+		/**
+		 * Log replacing a file.
+		 * @param File path.
+		 * @param New contents.
+		 * @param If the contents aren't text, in which case they are logged as hex.
+		 */
+		void log_write(const std::string& path, const std::string& contents, bool binary = false);
+
+		/**
+		 * Make every logged change durable.
+		 */
+		void flush();
+
+		/**
+		 * Remove the journal once the operation is complete.
+		 */
+		void finish();
+
+		/**
+		 * Complete an interrupted operation.
+		 * @param Desktop backend.
+		 * @param Path to the journal file.
+		 * @return If nothing is left to recover. If a change couldn't be made the journal is kept and nothing after it is done.
+		 */
+		static bool recover(DesktopBackend& backend, const std::string& path);
+
+	private:
+
+		/** Desktop backend. */
+		DesktopBackend& m_backend;
+
+		/** Path to the journal file. */
+		const std::string m_path;
+
+		/** Changes logged since the last flush. */
+		nlohmann::json m_pending;
+
+		/** If the journal file has been created. */
+		bool m_started = false;
+	};
+}
@@ -0,0 +1,111 @@
+/**
+ * @file thread_pool.cpp
+ * @brief Thread pool source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include "thread_pool.hpp"
+
+namespace ds
+{
+	ThreadPool::ThreadPool(size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::thread::hardware_concurrency();
+
+		// The calling thread works too
+		for (size_t i = 1; i < thread_count; ++i)
+			m_threads.emplace_back(&ThreadPool::worker, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+
+		m_wake.notify_all();
+		for (auto& thread : m_threads)
+			thread.join();
+	}
+
+	void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& task)
+	{
+		if (count == 0) return;
+
+		// Not worth waking anyone up
+		if (count == 1 || m_threads.empty())
+		{
+			for (size_t i = 0; i < count; ++i)
+				task(i);
+			return;
+		}
+
+		std::lock_guard<std::mutex> job_lock(m_job_mutex);
+
+		// Publish the job
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_task = &task;
+			m_count = count;
+			m_next = 0;
+			m_active = m_threads.size();
+			m_exception = nullptr;
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		// Help out
+		drain();
+
+		// Wait for the workers
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_active == 0; });
+		m_task = nullptr;
+
+		if (m_exception != nullptr)
+			std::rethrow_exception(m_exception);
+	}
+
+	void ThreadPool::worker()
+	{
+		uint64_t generation = 0;
+
+		while (true)
+		{
+			// Wait for a new job
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+				if (m_stopping) return;
+				generation = m_generation;
+			}
+
+			drain();
+
+			// Report back
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_active;
+			}
+			m_done.notify_one();
+		}
+	}
+
+	void ThreadPool::drain()
+	{
+		for (size_t i = m_next++; i < m_count; i = m_next++)
+		{
+			try
+			{ (*m_task)(i); }
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_exception == nullptr)
+					m_exception = std::current_exception();
+			}
+		}
+	}
+}
\ No newline at end of file
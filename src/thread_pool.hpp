@@ -0,0 +1,106 @@
+#pragma once
+
+/**
+ * @file thread_pool.hpp
+ * @brief Thread pool header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ds
+{
+	/**
+	 * Fixed size pool of worker threads.
+	 */
+	class ThreadPool
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Number of threads, including the calling thread. 0 uses the number of cores.
+		 */
+		explicit ThreadPool(size_t thread_count = 0);
+
+		/**
+		 * Destructor.
+		 */
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/**
+		 * Get the number of threads working on a job, including the calling thread.
+		 * @return Number of threads.
+		 */
+		inline size_t get_thread_count() const noexcept;
+
+		/**
+		 * Run a task for every index in [0, count) and wait for all of them to finish.
+		 * @param Number of indices.
+		 * @param Task to run.
+		 * @note The first exception thrown by a task is rethrown here.
+		 */
+		void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+	private:
+
+		/**
+		 * Worker thread entry point.
+		 */
+		void worker();
+
+		/**
+		 * Run tasks until the current job runs out of indices.
+		 */
+		void drain();
+
+		/** Worker threads. */
+		std::vector<std::thread> m_threads = {};
+
+		/** Only one job may run at a time. */
+		std::mutex m_job_mutex = {};
+
+		/** Guards the job state below. */
+		std::mutex m_mutex = {};
+
+		/** Signaled when a new job starts or the pool stops. */
+		std::condition_variable m_wake = {};
+
+		/** Signaled when a worker finishes a job. */
+		std::condition_variable m_done = {};
+
+		/** Current task. */
+		const std::function<void(size_t)>* m_task = nullptr;
+
+		/** Number of indices in the current job. */
+		size_t m_count = 0;
+
+		/** Next index to hand out. */
+		std::atomic<size_t> m_next = { 0 };
+
+		/** Number of workers still working on the current job. */
+		size_t m_active = 0;
+
+		/** Incremented for every job. */
+		uint64_t m_generation = 0;
+
+		/** First exception thrown by the current job. */
+		std::exception_ptr m_exception = nullptr;
+
+		/** If the workers should exit. */
+		bool m_stopping = false;
+	};
+}
+
+#include "thread_pool.imp.hpp"
\ No newline at end of file
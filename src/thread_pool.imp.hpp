@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * @file thread_pool.imp.hpp
+ * @brief Thread pool header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline size_t ThreadPool::get_thread_count() const noexcept
+	{
+		return m_threads.size() + 1;
+	}
+}
\ No newline at end of file
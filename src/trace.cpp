@@ -0,0 +1,203 @@
+/**
+ * @file trace.cpp
+ * @brief Trace spans source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "layout_json.hpp"
+#include "trace.hpp"
+
+namespace
+{
+	/**
+	 * A finished span.
+	 */
+	struct TraceEvent
+	{
+		/** Span name. */
+		const char* name = "";
+
+		/** Detail, or empty. */
+		std::string detail = "";
+
+		/** Start, in microseconds since recording started. */
+		double start = 0.0;
+
+		/** Duration in microseconds. */
+		double duration = 0.0;
+
+		/** Thread, numbered in the order threads first recorded a span. */
+		uint32_t thread = 0;
+	};
+
+	/** If spans are being recorded. */
+	std::atomic<bool> g_recording(false);
+
+	/** Guards everything below. */
+	std::mutex g_mutex;
+
+	/** Path of the trace file. */
+	std::string g_path = "";
+
+	/** When recording started. */
+	std::chrono::steady_clock::time_point g_origin = {};
+
+	/** Finished spans. */
+	std::vector<TraceEvent> g_events = {};
+
+	/** Number of every thread that recorded a span. */
+	std::unordered_map<std::thread::id, uint32_t> g_threads = {};
+
+	/**
+	 * Get the length of the UTF-8 sequence at the start of some text.
+	 * @param Text.
+	 * @param End of the text.
+	 * @return Length of the sequence, or 0 if it isn't valid UTF-8.
+	 */
+	size_t utf8_sequence_length(const unsigned char* p, const unsigned char* end)
+	{
+		if (p[0] < 0x80) return 1;
+
+		// Lead byte gives the length and the range of the second byte, which rules out overlong forms, surrogates and code points past U+10FFFF
+		size_t length = 0;
+		unsigned char low = 0x80;
+		unsigned char high = 0xBF;
+		if (p[0] >= 0xC2 && p[0] <= 0xDF) length = 2;
+		else if (p[0] == 0xE0) { length = 3; low = 0xA0; }
+		else if (p[0] == 0xED) { length = 3; high = 0x9F; }
+		else if (p[0] >= 0xE1 && p[0] <= 0xEF) length = 3;
+		else if (p[0] == 0xF0) { length = 4; low = 0x90; }
+		else if (p[0] == 0xF4) { length = 4; high = 0x8F; }
+		else if (p[0] >= 0xF1 && p[0] <= 0xF3) length = 4;
+		else return 0;
+
+		if (static_cast<size_t>(end - p) < length || p[1] < low || p[1] > high) return 0;
+		for (size_t i = 2; i < length; ++i)
+			if (p[i] < 0x80 || p[i] > 0xBF) return 0;
+
+		return length;
+	}
+
+	/**
+	 * Make text valid UTF-8, since trace viewers reject files that aren't.
+	 * @param Text.
+	 * @return Text with every invalid byte replaced by U+FFFD.
+	 */
+	std::string to_valid_utf8(const std::string& str)
+	{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(str.data());
+		const unsigned char* const end = p + str.size();
+
+		std::string out = {};
+		out.reserve(str.size());
+		while (p != end)
+		{
+			const size_t length = utf8_sequence_length(p, end);
+			if (length == 0)
+			{
+				out += "\xEF\xBF\xBD";
+				++p;
+			}
+			else
+			{
+				out.append(reinterpret_cast<const char*>(p), length);
+				p += length;
+			}
+		}
+
+		return out;
+	}
+}
+
+namespace ds
+{
+	bool Tracer::start(const std::string& path)
+	{
+#if defined(DS_TRACING)
+		std::lock_guard<std::mutex> lock(g_mutex);
+		g_path = path;
+		g_origin = std::chrono::steady_clock::now();
+		g_events.clear();
+		g_threads.clear();
+		g_recording = true;
+		return true;
+#else
+		(void)path;
+		return false;
+#endif
+	}
+
+	bool Tracer::stop()
+	{
+		if (!g_recording.exchange(false))
+			return false;
+
+		std::lock_guard<std::mutex> lock(g_mutex);
+
+		// Complete ("X") events, one per span
+		std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		char numbers[96];
+		for (size_t i = 0; i < g_events.size(); ++i)
+		{
+			const TraceEvent& event = g_events[i];
+			if (i != 0) out += ',';
+			out += "\n{\"name\":";
+			append_json_string(out, event.name);
+			std::snprintf(numbers, sizeof(numbers), ",\"cat\":\"ds\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				event.thread, event.start, event.duration);
+			out += numbers;
+
+			if (!event.detail.empty())
+			{
+				out += ",\"args\":{\"detail\":";
+				append_json_string(out, to_valid_utf8(event.detail));
+				out += '}';
+			}
+			out += '}';
+		}
+		out += "\n]}\n";
+
+		g_events.clear();
+		g_threads.clear();
+
+		std::ofstream stream(g_path, std::ios::binary);
+		stream << out;
+		return static_cast<bool>(stream);
+	}
+
+	bool Tracer::is_recording() noexcept
+	{
+		return g_recording.load(std::memory_order_relaxed);
+	}
+
+	void Tracer::record(const char* name, std::string detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		// Spans end in destructors, so running out of memory only loses the span
+		try
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			if (!g_recording) return;
+
+			TraceEvent event = {};
+			event.name = name;
+			event.detail = std::move(detail);
+			event.start = std::chrono::duration<double, std::micro>(start - g_origin).count();
+			event.duration = std::chrono::duration<double, std::micro>(end - start).count();
+
+			const auto thread = g_threads.emplace(std::this_thread::get_id(), static_cast<uint32_t>(g_threads.size() + 1));
+			event.thread = thread.first->second;
+
+			g_events.push_back(std::move(event));
+		}
+		catch (...)
+		{}
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * @file trace.hpp
+ * @brief Trace spans header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <chrono>
+#include <string>
+
+/**
+ * Trace the rest of the scope.
+ * @param Span name, a string literal.
+ * @note Compiles to nothing unless DS_TRACING is defined.
+ */
+#if defined(DS_TRACING)
+#define DS_TRACE_SCOPE(name) ds::TraceSpan DS_TRACE_JOIN(ds_trace_span_, __LINE__)(name)
+#else
+#define DS_TRACE_SCOPE(name)
+#endif
+
+/**
+ * Trace the rest of the scope with a detail, like the file or icon the span is about.
+ * @param Span name, a string literal.
+ * @param Detail. Not evaluated unless a trace is being recorded.
+ * @note Compiles to nothing unless DS_TRACING is defined.
+ */
+#if defined(DS_TRACING)
+#define DS_TRACE_SCOPE_DETAIL(name, detail) ds::TraceSpan DS_TRACE_JOIN(ds_trace_span_, __LINE__)(name); \
+	if (DS_TRACE_JOIN(ds_trace_span_, __LINE__).is_recording()) DS_TRACE_JOIN(ds_trace_span_, __LINE__).set_detail(detail)
+#else
+#define DS_TRACE_SCOPE_DETAIL(name, detail)
+#endif
+
+/** Token pasting, after expanding __LINE__. */
+#define DS_TRACE_JOIN(a, b) DS_TRACE_JOIN_IMP(a, b)
+#define DS_TRACE_JOIN_IMP(a, b) a##b
+
+namespace ds
+{
+	/**
+	 * Records trace spans and writes them out as Chrome trace_event JSON, which Perfetto and
+	 * chrome://tracing open.
+	 */
+	class Tracer
+	{
+	public:
+
+		Tracer() = delete;
+
+		/**
+		 * Start recording.
+		 * @param Path of the trace file to write when recording stops.
+		 * @return If tracing was compiled in.
+		 */
+		static bool start(const std::string& path);
+
+		/**
+		 * Stop recording and write the trace file.
+		 * @return If the file was written.
+		 */
+		static bool stop();
+
+		/**
+		 * Check if spans are being recorded.
+		 * @return If spans are being recorded.
+		 */
+		static bool is_recording() noexcept;
+
+		/**
+		 * Record a finished span.
+		 * @param Span name.
+		 * @param Detail, or empty.
+		 * @param Start time.
+		 * @param End time.
+		 */
+		static void record(const char* name, std::string detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	};
+
+	/**
+	 * Times a scope and records it with the tracer.
+	 */
+	class TraceSpan
+	{
+	public:
+
+		/**
+		 * Constructor. Starts the span if a trace is being recorded.
+		 * @param Span name, which must outlive the trace.
+		 */
+		explicit inline TraceSpan(const char* name) noexcept;
+
+		/**
+		 * Destructor. Records the span.
+		 */
+		inline ~TraceSpan();
+
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+
+		/**
+		 * Check if the span will be recorded.
+		 * @return If the span will be recorded.
+		 */
+		inline bool is_recording() const noexcept;
+
+		/**
+		 * Set the detail shown with the span.
+		 * @param Detail.
+		 */
+		inline void set_detail(std::string detail);
+
+	private:
+
+		/** Span name. */
+		const char* m_name;
+
+		/** If the span will be recorded. */
+		const bool m_recording;
+
+		/** Detail, or empty. */
+		std::string m_detail = "";
+
+		/** Start time. */
+		std::chrono::steady_clock::time_point m_start = {};
+	};
+}
+
+#include "trace.imp.hpp"
@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * @file trace.imp.hpp
+ * @brief Trace spans header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <utility>
+
+namespace ds
+{
+	inline TraceSpan::TraceSpan(const char* name) noexcept :
+		m_name(name),
+		m_recording(Tracer::is_recording())
+	{
+		if (m_recording)
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	inline TraceSpan::~TraceSpan()
+	{
+		if (m_recording)
+			Tracer::record(m_name, std::move(m_detail), m_start, std::chrono::steady_clock::now());
+	}
+
+	inline bool TraceSpan::is_recording() const noexcept
+	{
+		return m_recording;
+	}
+
+	inline void TraceSpan::set_detail(std::string detail)
+	{
+		m_detail = std::move(detail);
+	}
+}
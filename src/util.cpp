@@ -5,39 +5,38 @@
  */
 
 /** Includes. */
+#include <cstdlib>
+#include <stdexcept>
+#include "util.hpp"
+#include "trace.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 #include <shlobj.h>
 #include <codecvt>
-#include <atlbase.h>
-#include "util.hpp"
+#endif
 
 namespace ds
 {
-	void find_desktop_folder_view(REFIID riid, void** ppv)
+	std::string join_path(const std::string& parent, const std::string& child)
+	{
+		if (parent.empty() || parent.back() == path_separator)
+			return parent + child;
+
+		return parent + path_separator + child;
+	}
+
+	std::string get_parent_path(const std::string& path)
 	{
-		// Create a shell window object
-		CComPtr<IShellWindows> shell_windows = nullptr;
-		HRESULT res = shell_windows.CoCreateInstance(CLSID_ShellWindows);
-		if (res != S_OK) throw std::runtime_error("Unable to find a shell window.");
-
-		// Use the shell window object to locate the desktop
-		CComVariant loc(CSIDL_DESKTOP);
-		CComVariant dummy = {};
-		long hwnd = NULL;
-		CComPtr<IDispatch> dispatch = nullptr;
-		shell_windows->FindWindowSW(&loc, &dummy, SWC_DESKTOP, &hwnd, SWFO_NEEDDISPATCH, &dispatch);
-		if (dispatch == nullptr) throw std::runtime_error("Unable to locate the desktop.");
-
-		// Ask for a browser object so we can do stuff to the desktop
-		CComPtr<IShellBrowser> browser = nullptr;
-		CComQIPtr<IServiceProvider>(dispatch)->QueryService(SID_STopLevelBrowser, IID_PPV_ARGS(&browser));
-
-		// Find the shell view
-		CComPtr<IShellView> view = nullptr;
-		browser->QueryActiveShellView(&view);
-		if (view == nullptr) throw std::runtime_error("Unable to find a shell view.");
-
-		// Ask for a IFolderView interface
-		view->QueryInterface(riid, ppv);
+		const size_t end = path.find_last_not_of(path_separator);
+		if (end == std::string::npos) return "";
+
+		const size_t separator = path.find_last_of(path_separator, end);
+		if (separator == std::string::npos) return "";
+		if (separator == 0) return path.substr(0, 1);
+
+		return path.substr(0, separator);
 	}
 
 	bool compare_file_names(const std::string n1, const std::string n2)
@@ -60,6 +59,7 @@ namespace ds
 		}
 	}
 
+#if defined(_WIN32)
 	std::string wide_to_reg(const std::wstring wstr)
 	{
 		using ct = std::codecvt_utf8<wchar_t>;
@@ -74,66 +74,10 @@ namespace ds
 		return converter.from_bytes(str);
 	}
 
-	std::string get_desktop_path()
-	{
-		// Get the path to the AppData folder
-		PWSTR c_path = NULL;
-		auto res = SHGetKnownFolderPath(FOLDERID_Desktop, KF_FLAG_DEFAULT, NULL, &c_path);
-
-		if (res != S_OK)
-		{
-			// Free the C string
-			CoTaskMemFree(c_path);
-			throw std::runtime_error("Unable to locate the Desktop folder");
-		}
-
-		// Convert the path into a more C++ friendly format
-		std::wstring path(c_path);
-
-		// Free the C string
-		CoTaskMemFree(c_path);
-
-		return wide_to_reg(path);
-	}
-
-	std::vector<std::string> get_desktop_file_names()
-	{
-		// Get path to the desktop
-		const std::string desktop = get_desktop_path() + "\\*";
-
-		// List of files
-		std::vector<std::string> files = {};
-
-		// Found file data
-		WIN32_FIND_DATA ffd = {};
-
-		// Get the first file on the desktop
-		HANDLE file = FindFirstFile(desktop.c_str(), &ffd);
-
-		// Start adding files
-		if (file != NULL)
-		{
-			// Loop until we can find no more files
-			do
-			{
-				// We don't care about these files
-				if (std::strcmp(ffd.cFileName, ".") == 0 || std::strcmp(ffd.cFileName, "..") == 0)
-					continue;
-
-				// Add the files name
-				files.push_back(ffd.cFileName);
-
-			} while (FindNextFile(file, &ffd) != NULL);
-		}
-
-		// Close the file
-		FindClose(file);
-
-		return files;
-	}
-
 	std::string get_desktop_saver_path()
 	{
+		DS_TRACE_SCOPE("get_desktop_saver_path");
+
 		// Get the path to the AppData folder
 		PWSTR c_path = NULL;
 		auto res = SHGetKnownFolderPath(FOLDERID_RoamingAppData, KF_FLAG_DEFAULT, NULL, &c_path);
@@ -156,4 +100,22 @@ namespace ds
 
 		return wide_to_reg(path);
 	}
+#else
+	std::string get_desktop_saver_path()
+	{
+		DS_TRACE_SCOPE("get_desktop_saver_path");
+
+		// Prefer the XDG data folder
+		const char* data_home = std::getenv("XDG_DATA_HOME");
+		if (data_home != nullptr && data_home[0] != '\0')
+			return join_path(data_home, "Desktop-Saver");
+
+		// Fall back to the default location in the home folder
+		const char* home = std::getenv("HOME");
+		if (home == nullptr || home[0] == '\0')
+			throw std::runtime_error("Unable to locate the home folder");
+
+		return join_path(join_path(home, ".local/share"), "Desktop-Saver");
+	}
+#endif
 }
\ No newline at end of file
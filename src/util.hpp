@@ -6,16 +6,33 @@
  * @author Connor J. Bramham (ReeCocho)
  */
 
- /** Don't need extra includes */
-#define WIN32_LEAN_AND_MEAN
-
 /** Includes. */
-#include <windows.h>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
 namespace ds
 {
+	/** Path separator of the host platform. */
+#if defined(_WIN32)
+	constexpr char path_separator = '\\';
+#else
+	constexpr char path_separator = '/';
+#endif
+
+	/**
+	 * Position of an icon on the desktop.
+	 */
+	struct IconPoint
+	{
+		/** X coordinate. */
+		int32_t x = 0;
+
+		/** Y coordinate. */
+		int32_t y = 0;
+	};
+
 	/**
 	 * Desktop icon data.
 	 */
@@ -25,15 +42,72 @@ namespace ds
 		std::string name = "";
 
 		/** Location. */
-		POINT point = {};
+		IconPoint point = {};
 	};
 
 	/**
-	 * Find the desktop folder view.
-	 * @param Reference ID.
-	 * @param Pointer to pointer of IFolderView.
+	 * Non-owning reference to a name stored elsewhere.
 	 */
-	extern void find_desktop_folder_view(REFIID riid, void** ppv);
+	struct NameRef
+	{
+		/** First character. */
+		const char* data = nullptr;
+
+		/** Number of characters. */
+		size_t size = 0;
+	};
+
+	/**
+	 * Refer to a string as a name.
+	 * @param String.
+	 * @return Name, valid while the string is unchanged.
+	 */
+	inline NameRef make_name_ref(const std::string& str) noexcept
+	{
+		NameRef name = {};
+		name.data = str.data();
+		name.size = str.size();
+		return name;
+	}
+
+	/**
+	 * Compare two names.
+	 * @param First name.
+	 * @param Second name.
+	 * @return If the names are the same.
+	 */
+	inline bool operator==(const NameRef& n1, const NameRef& n2) noexcept
+	{
+		return n1.size == n2.size && (n1.size == 0 || std::memcmp(n1.data, n2.data, n1.size) == 0);
+	}
+
+	/**
+	 * Hash a name (FNV-1a).
+	 * @param Name.
+	 * @return Hash.
+	 */
+	inline uint64_t hash_name(const NameRef& name) noexcept
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < name.size; ++i)
+			hash = (hash ^ static_cast<unsigned char>(name.data[i])) * 1099511628211ull;
+		return hash;
+	}
+
+	/**
+	 * Join two path components with the platform separator.
+	 * @param Parent path.
+	 * @param Child name.
+	 * @return Joined path.
+	 */
+	extern std::string join_path(const std::string& parent, const std::string& child);
+
+	/**
+	 * Get the folder a path lives in.
+	 * @param Path.
+	 * @return Parent path, or an empty string if there is none.
+	 */
+	extern std::string get_parent_path(const std::string& path);
 
 	/**
 	 * Compare two file names to see if they are "equal."
@@ -43,6 +117,7 @@ namespace ds
 	 */
 	extern bool compare_file_names(const std::string n1, const std::string n2);
 
+#if defined(_WIN32)
 	/**
 	 * Convert a wide string into a regular string.
 	 * @param Wide string.
@@ -56,22 +131,12 @@ namespace ds
 	 * @return Wide string.
 	 */
 	extern std::wstring reg_to_wide(const std::string str);
-
-	/**
-	 * Get the desktop path.
-	 * @return Desktop path.
-	 */
-	extern std::string get_desktop_path();
-
-	/**
-	 * Get a list of files on the desktop.
-	 * @return Files on the desktop.
-	 */
-	extern std::vector<std::string> get_desktop_file_names();
+#endif
 
 	/**
 	 * Get the Desktop-Saver path.
 	 * @return Desktop-Saver path.
+	 * @note On Linux this is $XDG_DATA_HOME/Desktop-Saver.
 	 */
 	extern std::string get_desktop_saver_path();
 }
\ No newline at end of file
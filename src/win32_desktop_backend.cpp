@@ -0,0 +1,498 @@
+/**
+ * @file win32_desktop_backend.cpp
+ * @brief Windows desktop backend source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "win32_desktop_backend.hpp"
+#include "trace.hpp"
+
+/** Windows */
+#include <combaseapi.h>
+#include <winerror.h>
+#include <commctrl.h>
+#include <shellapi.h>
+#include <shlwapi.h>
+
+namespace
+{
+	/**
+	 * Keep track of how much a copy has written.
+	 * @param Bytes copied so far output.
+	 * @return PROGRESS_CONTINUE.
+	 */
+	DWORD CALLBACK copy_progress(LARGE_INTEGER, LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID data)
+	{
+		*static_cast<uint64_t*>(data) = static_cast<uint64_t>(transferred.QuadPart);
+		return PROGRESS_CONTINUE;
+	}
+
+	/**
+	 * Remove a file or folder and everything in it.
+	 * @param Path.
+	 * @return If everything was removed.
+	 */
+	bool remove_tree(const std::string& path)
+	{
+		// The shell takes a list of paths ending in an empty one
+		std::string paths = path;
+		paths.push_back('\0');
+
+		SHFILEOPSTRUCT operation = {};
+		operation.wFunc = FO_DELETE;
+		operation.pFrom = paths.c_str();
+		operation.fFlags = FOF_NO_UI;
+		return SHFileOperation(&operation) == 0 && operation.fAnyOperationsAborted == FALSE;
+	}
+
+	/**
+	 * Duplicate a file or folder, hard linking files where possible.
+	 * @param Source path.
+	 * @param Destination path.
+	 * @param Clone statistics to add to.
+	 * @return If everything was duplicated. Partial copies are left behind.
+	 */
+	bool clone_entry(const std::string& from, const std::string& to, ds::CloneStats& stats)
+	{
+		const DWORD attributes = GetFileAttributes(from.c_str());
+		if (attributes == INVALID_FILE_ATTRIBUTES) return false;
+
+		// Folders are recreated and filled one entry at a time
+		if ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0 && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+		{
+			if (CreateDirectoryEx(from.c_str(), to.c_str(), NULL) == FALSE)
+				return false;
+
+			WIN32_FIND_DATA ffd = {};
+			HANDLE file = FindFirstFile(ds::join_path(from, "*").c_str(), &ffd);
+			if (file == INVALID_HANDLE_VALUE) return false;
+
+			bool cloned = true;
+			do
+			{
+				if (std::strcmp(ffd.cFileName, ".") == 0 || std::strcmp(ffd.cFileName, "..") == 0)
+					continue;
+
+				cloned = clone_entry(ds::join_path(from, ffd.cFileName), ds::join_path(to, ffd.cFileName), stats);
+
+			} while (cloned && FindNextFile(file, &ffd) != FALSE);
+
+			FindClose(file);
+			return cloned;
+		}
+
+		// NTFS can't share data between files, so a hard link is the cheapest
+		if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0 && CreateHardLink(to.c_str(), from.c_str(), NULL) != FALSE)
+		{
+			++stats.linked;
+			return true;
+		}
+
+		uint64_t bytes = 0;
+		if (CopyFileEx(from.c_str(), to.c_str(), copy_progress, &bytes, NULL, COPY_FILE_FAIL_IF_EXISTS | COPY_FILE_COPY_SYMLINK) == FALSE)
+			return false;
+
+		++stats.copied;
+		stats.copied_bytes += bytes;
+		return true;
+	}
+}
+
+namespace ds
+{
+	std::unique_ptr<DesktopBackend> create_desktop_backend()
+	{
+		return std::make_unique<Win32DesktopBackend>();
+	}
+
+	Win32DesktopBackend::Win32DesktopBackend()
+	{
+		// Initialize the COM library
+		CoInitialize(NULL);
+	}
+
+	Win32DesktopBackend::~Win32DesktopBackend()
+	{
+		// Release shell objects before COM goes away
+		clear_items();
+		m_session.reset();
+		CoUninitialize();
+
+		if (m_change != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(m_change);
+	}
+
+	std::string Win32DesktopBackend::get_desktop_path()
+	{
+		// Get the path to the AppData folder
+		PWSTR c_path = NULL;
+		auto res = SHGetKnownFolderPath(FOLDERID_Desktop, KF_FLAG_DEFAULT, NULL, &c_path);
+
+		if (res != S_OK)
+		{
+			// Free the C string
+			CoTaskMemFree(c_path);
+			throw std::runtime_error("Unable to locate the Desktop folder");
+		}
+
+		// Convert the path into a more C++ friendly format
+		std::wstring path(c_path);
+
+		// Free the C string
+		CoTaskMemFree(c_path);
+
+		return wide_to_reg(path);
+	}
+
+	size_t Win32DesktopBackend::get_item_count()
+	{
+		auto view = m_session.get_view();
+
+		int icon_count = -1;
+		view->ItemCount(SVGIO_ALLVIEW, &icon_count);
+		if (icon_count == -1) throw std::runtime_error("Unable to get the number of icons.");
+
+		return static_cast<size_t>(icon_count);
+	}
+
+	std::vector<DesktopIcon> Win32DesktopBackend::get_icons()
+	{
+		DS_TRACE_SCOPE("Win32DesktopBackend::get_icons");
+
+		// Forget the previous enumeration
+		clear_items();
+		return enumerate_items();
+	}
+
+	std::vector<DesktopIcon> Win32DesktopBackend::get_new_icons()
+	{
+		DS_TRACE_SCOPE("Win32DesktopBackend::get_new_icons");
+
+		// New items are added to the end of the view while auto arrange is off
+		return enumerate_items();
+	}
+
+	std::vector<DesktopIcon> Win32DesktopBackend::enumerate_items()
+	{
+		auto view = m_session.get_view();
+		auto shell = m_session.get_folder();
+
+		// List of icons
+		std::vector<DesktopIcon> icons = {};
+
+		// Ask for an item enumeration object
+		CComPtr<IEnumIDList> item_enum = nullptr;
+		view->Items(SVGIO_ALLVIEW, IID_PPV_ARGS(&item_enum));
+		if (item_enum == nullptr) throw std::runtime_error("Unable to get item enumerator.");
+
+		// Skip the items already remembered, without asking for their names or positions
+		if (!m_items.empty() && item_enum->Skip(static_cast<ULONG>(m_items.size())) != S_OK)
+			return icons;
+
+		// Loop over every item
+		for (CComHeapPtr<ITEMID_CHILD> item; item_enum->Next(1, &item, nullptr) == S_OK; )
+		{
+			// Get the icon's name
+			STRRET str = {};
+			shell->GetDisplayNameOf(item, SHGDN_NORMAL, &str);
+			CComHeapPtr<char> name = {};
+			StrRetToStr(&str, item, &name);
+
+			// Get the icon's location
+			POINT pt = {};
+			view->GetItemPosition(item, &pt);
+
+			// Store icon data
+			DesktopIcon icon = {};
+			icon.name = name;
+			icon.point.x = static_cast<int32_t>(pt.x);
+			icon.point.y = static_cast<int32_t>(pt.y);
+			icons.push_back(icon);
+
+			// Keep the item around so it can be positioned later
+			m_items.push_back(item.Detach());
+		}
+
+		return icons;
+	}
+
+	void Win32DesktopBackend::set_icon_position(size_t item, const IconPoint& point)
+	{
+		auto view = m_session.get_view();
+
+		POINT p = {};
+		p.x = point.x;
+		p.y = point.y;
+
+		PCITEMID_CHILD child_item[1] = { m_items[item] };
+		view->SelectAndPositionItems(1, child_item, &p, SVSI_POSITIONITEM);
+	}
+
+	void Win32DesktopBackend::set_icon_positions(const std::vector<IconPlacement>& placements)
+	{
+		DS_TRACE_SCOPE("Win32DesktopBackend::set_icon_positions");
+
+		auto view = m_session.get_view();
+
+		std::vector<PCITEMID_CHILD> items = {};
+		std::vector<POINT> points = {};
+		for (size_t start = 0; start < placements.size(); start += icon_batch_size)
+		{
+			// One round trip to the shell per batch
+			const size_t count = std::min(icon_batch_size, placements.size() - start);
+			items.resize(count);
+			points.resize(count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto& placement = placements[start + i];
+				items[i] = m_items[placement.item];
+				points[i].x = placement.point.x;
+				points[i].y = placement.point.y;
+			}
+
+			view->SelectAndPositionItems(static_cast<UINT>(count), items.data(), points.data(), SVSI_POSITIONITEM);
+		}
+	}
+
+	void Win32DesktopBackend::set_grid_alignment(bool enabled)
+	{
+		auto view = m_session.get_view();
+
+		if (enabled)
+			view->SetCurrentFolderFlags(FWF_SNAPTOGRID, FWF_SNAPTOGRID);
+		else
+			view->SetCurrentFolderFlags(FWF_AUTOARRANGE | FWF_SNAPTOGRID, 0);
+	}
+
+	void Win32DesktopBackend::refresh_view()
+	{
+		SendMessage(GetDesktopWindow(), WM_KEYDOWN, VK_F5, 0);
+	}
+
+	void Win32DesktopBackend::set_view_redraw(bool enabled)
+	{
+		// The icons are drawn by the list view inside the shell view
+		HWND list_view = m_session.get_list_view();
+		if (list_view == NULL) return;
+
+		SendMessage(list_view, WM_SETREDRAW, enabled ? TRUE : FALSE, 0);
+		if (enabled)
+			RedrawWindow(list_view, NULL, NULL, RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+	}
+
+	std::vector<std::string> Win32DesktopBackend::list_files(const std::string& path)
+	{
+		// List of files
+		std::vector<std::string> files = {};
+
+		// Found file data
+		WIN32_FIND_DATA ffd = {};
+
+		// Get the first file in the folder
+		HANDLE file = FindFirstFile((path + "\\*").c_str(), &ffd);
+		if (file == INVALID_HANDLE_VALUE) return files;
+
+		// Loop until we can find no more files
+		do
+		{
+			// We don't care about these files
+			if (std::strcmp(ffd.cFileName, ".") == 0 || std::strcmp(ffd.cFileName, "..") == 0)
+				continue;
+
+			// Add the files name
+			files.push_back(ffd.cFileName);
+
+		} while (FindNextFile(file, &ffd) != FALSE);
+
+		// Close the file
+		FindClose(file);
+
+		return files;
+	}
+
+	bool Win32DesktopBackend::move_file(const std::string& from, const std::string& to)
+	{
+		if (MoveFileEx(from.c_str(), to.c_str(), 0) != FALSE)
+			return true;
+
+		// The saves live on another volume, so the data has to be copied
+		if (GetLastError() != ERROR_NOT_SAME_DEVICE)
+			return false;
+
+		// Write through so the copy is on disk before the source is deleted
+		uint64_t bytes = 0;
+		if (MoveFileWithProgress(from.c_str(), to.c_str(), copy_progress, &bytes, MOVEFILE_COPY_ALLOWED | MOVEFILE_WRITE_THROUGH) == FALSE)
+			return false;
+
+		// A source that couldn't be deleted is left intact, so drop the copy and keep it the only one
+		if (GetFileAttributes(from.c_str()) != INVALID_FILE_ATTRIBUTES)
+		{
+			remove_tree(to);
+			return false;
+		}
+
+		record_copy(bytes);
+		return true;
+	}
+
+	bool Win32DesktopBackend::clone_file(const std::string& from, const std::string& to, CloneStats& stats)
+	{
+		DS_TRACE_SCOPE_DETAIL("clone", from);
+
+		// Never merge into or overwrite something already there
+		if (GetFileAttributes(to.c_str()) != INVALID_FILE_ATTRIBUTES)
+			return false;
+
+		// Only count what ends up in the clone
+		CloneStats cloned = {};
+		if (!clone_entry(from, to, cloned))
+		{
+			remove_tree(to);
+			return false;
+		}
+
+		stats.linked += cloned.linked;
+		stats.copied += cloned.copied;
+		stats.copied_bytes += cloned.copied_bytes;
+		return true;
+	}
+
+	bool Win32DesktopBackend::remove_tree(const std::string& path)
+	{
+		return ::remove_tree(path) || !file_exists(path);
+	}
+
+	bool Win32DesktopBackend::replace_file(const std::string& from, const std::string& to)
+	{
+		return MoveFileEx(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+	}
+
+	bool Win32DesktopBackend::sync_file(const std::string& path)
+	{
+		HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		const bool synced = FlushFileBuffers(file) != FALSE;
+		CloseHandle(file);
+		return synced;
+	}
+
+	bool Win32DesktopBackend::sync_directory(const std::string& path)
+	{
+		// Folders can only be opened with backup semantics
+		HANDLE dir = CreateFile(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if (dir == INVALID_HANDLE_VALUE) return false;
+
+		const bool synced = FlushFileBuffers(dir) != FALSE;
+		CloseHandle(dir);
+		return synced;
+	}
+
+	bool Win32DesktopBackend::exchange_directories(const std::string& a, const std::string& b)
+	{
+		// Explorer holds the desktop folder open, so it can't be renamed
+		(void)a;
+		(void)b;
+		return false;
+	}
+
+	bool Win32DesktopBackend::supports_exchange() const
+	{
+		return false;
+	}
+
+	bool Win32DesktopBackend::same_filesystem(const std::string& a, const std::string& b)
+	{
+		char volume_a[MAX_PATH] = {};
+		char volume_b[MAX_PATH] = {};
+		if (GetVolumePathName(a.c_str(), volume_a, MAX_PATH) == FALSE) return false;
+		if (GetVolumePathName(b.c_str(), volume_b, MAX_PATH) == FALSE) return false;
+
+		return lstrcmpi(volume_a, volume_b) == 0;
+	}
+
+	bool Win32DesktopBackend::get_file_info(const std::string& path, FileInfo& info)
+	{
+		// Folders can only be opened with backup semantics
+		HANDLE file = CreateFile(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		BY_HANDLE_FILE_INFORMATION data = {};
+		const bool found = GetFileInformationByHandle(file, &data) != FALSE;
+		CloseHandle(file);
+		if (!found) return false;
+
+		// FILETIME counts 100ns ticks since 1601
+		const int64_t ticks = (static_cast<int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+		info.id = (static_cast<uint64_t>(data.nFileIndexHigh) << 32) | data.nFileIndexLow;
+		info.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		info.modified = (ticks - 116444736000000000LL) * 100;
+		info.directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		return true;
+	}
+
+	bool Win32DesktopBackend::is_link(const std::string& path)
+	{
+		const DWORD attributes = GetFileAttributes(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+	}
+
+	bool Win32DesktopBackend::set_link(const std::string& link, const std::string& target)
+	{
+		// Both a folder link and an empty folder are removed the same way
+		if (file_exists(link) && RemoveDirectory(link.c_str()) == FALSE)
+			return false;
+
+		const DWORD flags = SYMBOLIC_LINK_FLAG_DIRECTORY | SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE;
+		return CreateSymbolicLink(link.c_str(), target.c_str(), flags) != FALSE;
+	}
+
+	bool Win32DesktopBackend::remove_link(const std::string& link)
+	{
+		return is_link(link) && RemoveDirectory(link.c_str()) != FALSE;
+	}
+
+	bool Win32DesktopBackend::create_directory(const std::string& path)
+	{
+		return CreateDirectory(path.c_str(), NULL) != FALSE || GetLastError() == ERROR_ALREADY_EXISTS;
+	}
+
+	bool Win32DesktopBackend::file_exists(const std::string& path)
+	{
+		return PathFileExists(path.c_str()) != FALSE;
+	}
+
+	bool Win32DesktopBackend::wait_for_change(std::chrono::milliseconds timeout)
+	{
+		// The view catches up some time after the folder changes, so this only hints when to look again
+		if (m_change == INVALID_HANDLE_VALUE)
+		{
+			m_change = FindFirstChangeNotification(get_desktop_path().c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME);
+			if (m_change == INVALID_HANDLE_VALUE)
+			{
+				Sleep(static_cast<DWORD>(timeout.count()));
+				return false;
+			}
+		}
+
+		if (WaitForSingleObject(m_change, static_cast<DWORD>(timeout.count())) != WAIT_OBJECT_0)
+			return false;
+
+		FindNextChangeNotification(m_change);
+		return true;
+	}
+
+	void Win32DesktopBackend::clear_items()
+	{
+		for (auto item : m_items)
+			CoTaskMemFree(item);
+
+		m_items.clear();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * @file win32_desktop_backend.hpp
+ * @brief Windows desktop backend header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+ /** Don't need extra includes */
+#define WIN32_LEAN_AND_MEAN
+
+/** Includes. */
+#include <windows.h>
+#include <shlobj.h>
+#include <atlbase.h>
+#include "desktop_backend.hpp"
+#include "win32_shell_session.hpp"
+
+namespace ds
+{
+	/**
+	 * Desktop backend talking to the Windows shell.
+	 */
+	class Win32DesktopBackend : public DesktopBackend
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @note Initializes the COM library for the calling thread.
+		 */
+		Win32DesktopBackend();
+
+		/**
+		 * Destructor.
+		 */
+		~Win32DesktopBackend() override;
+
+		std::string get_desktop_path() override;
+
+		size_t get_item_count() override;
+
+		std::vector<DesktopIcon> get_icons() override;
+
+		std::vector<DesktopIcon> get_new_icons() override;
+
+		void set_icon_position(size_t item, const IconPoint& point) override;
+
+		void set_icon_positions(const std::vector<IconPlacement>& placements) override;
+
+		void set_grid_alignment(bool enabled) override;
+
+		std::vector<std::string> list_files(const std::string& path) override;
+
+		bool move_file(const std::string& from, const std::string& to) override;
+
+		bool clone_file(const std::string& from, const std::string& to, CloneStats& stats) override;
+
+		bool remove_tree(const std::string& path) override;
+
+		bool replace_file(const std::string& from, const std::string& to) override;
+
+		bool sync_file(const std::string& path) override;
+
+		bool sync_directory(const std::string& path) override;
+
+		bool exchange_directories(const std::string& a, const std::string& b) override;
+
+		bool supports_exchange() const override;
+
+		bool same_filesystem(const std::string& a, const std::string& b) override;
+
+		bool get_file_info(const std::string& path, FileInfo& info) override;
+
+		bool is_link(const std::string& path) override;
+
+		bool set_link(const std::string& link, const std::string& target) override;
+
+		bool remove_link(const std::string& link) override;
+
+		bool create_directory(const std::string& path) override;
+
+		bool file_exists(const std::string& path) override;
+
+	protected:
+
+		void refresh_view() override;
+
+		void set_view_redraw(bool enabled) override;
+
+		bool wait_for_change(std::chrono::milliseconds timeout) override;
+
+	private:
+
+		/**
+		 * Free the items from the last enumeration.
+		 */
+		void clear_items();
+
+		/**
+		 * Enumerate the items of the view after the ones already remembered, and remember them too.
+		 * @return Desktop icons, in view order.
+		 */
+		std::vector<DesktopIcon> enumerate_items();
+
+		/** Connection to the shell, shared by every phase of a switch. */
+		ShellSession m_session = {};
+
+		/** Items from the last enumeration. */
+		std::vector<PITEMID_CHILD> m_items;
+
+		/** Change notifications for the desktop folder. */
+		HANDLE m_change = INVALID_HANDLE_VALUE;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+/**
+ * @file win32_shell_session.cpp
+ * @brief Windows shell session source file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <stdexcept>
+#include "win32_shell_session.hpp"
+
+/** Windows */
+#include <commctrl.h>
+
+namespace ds
+{
+	void find_desktop_folder_view(REFIID riid, void** ppv)
+	{
+		// Create a shell window object
+		CComPtr<IShellWindows> shell_windows = nullptr;
+		HRESULT res = shell_windows.CoCreateInstance(CLSID_ShellWindows);
+		if (res != S_OK) throw std::runtime_error("Unable to find a shell window.");
+
+		// Use the shell window object to locate the desktop
+		CComVariant loc(CSIDL_DESKTOP);
+		CComVariant dummy = {};
+		long hwnd = NULL;
+		CComPtr<IDispatch> dispatch = nullptr;
+		shell_windows->FindWindowSW(&loc, &dummy, SWC_DESKTOP, &hwnd, SWFO_NEEDDISPATCH, &dispatch);
+		if (dispatch == nullptr) throw std::runtime_error("Unable to locate the desktop.");
+
+		// Ask for a browser object so we can do stuff to the desktop
+		CComPtr<IShellBrowser> browser = nullptr;
+		CComQIPtr<IServiceProvider>(dispatch)->QueryService(SID_STopLevelBrowser, IID_PPV_ARGS(&browser));
+
+		// Find the shell view
+		CComPtr<IShellView> view = nullptr;
+		browser->QueryActiveShellView(&view);
+		if (view == nullptr) throw std::runtime_error("Unable to find a shell view.");
+
+		// Ask for a IFolderView interface
+		view->QueryInterface(riid, ppv);
+	}
+
+	CComPtr<IFolderView2> ShellSession::get_view()
+	{
+		revalidate();
+		if (m_view != nullptr) return m_view;
+
+		// Get a folder view for the desktop
+		++m_acquisitions;
+		find_desktop_folder_view(IID_PPV_ARGS(&m_view));
+		if (m_view == nullptr) throw std::runtime_error("Unable to locate a desktop view.");
+
+		// Remember the window so a restarted shell can be noticed
+		CComQIPtr<IShellView> shell_view(m_view);
+		if (shell_view != nullptr)
+			shell_view->GetWindow(&m_window);
+
+		return m_view;
+	}
+
+	CComPtr<IShellFolder> ShellSession::get_folder()
+	{
+		auto view = get_view();
+		if (m_folder != nullptr) return m_folder;
+
+		// Get the shell folder for the desktop
+		view->GetFolder(IID_PPV_ARGS(&m_folder));
+		if (m_folder == nullptr) throw std::runtime_error("Unable to locate a desktop folder.");
+
+		return m_folder;
+	}
+
+	HWND ShellSession::get_list_view()
+	{
+		get_view();
+		if (m_window == NULL) return NULL;
+
+		return FindWindowEx(m_window, NULL, WC_LISTVIEW, NULL);
+	}
+
+	void ShellSession::reset()
+	{
+		m_folder.Release();
+		m_view.Release();
+		m_window = NULL;
+	}
+
+	void ShellSession::revalidate()
+	{
+		// The window dies with the shell, and checking it is a single call
+		if (m_view != nullptr && m_window != NULL && !IsWindow(m_window))
+			reset();
+	}
+}
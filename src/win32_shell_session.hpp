@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * @file win32_shell_session.hpp
+ * @brief Windows shell session header file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+ /** Don't need extra includes */
+#define WIN32_LEAN_AND_MEAN
+
+/** Includes. */
+#include <windows.h>
+#include <shlobj.h>
+#include <atlbase.h>
+
+namespace ds
+{
+	/**
+	 * Find the desktop folder view.
+	 * @param Reference ID.
+	 * @param Pointer to pointer of IFolderView.
+	 */
+	extern void find_desktop_folder_view(REFIID riid, void** ppv);
+
+	/**
+	 * Connection to the desktop of the running shell.
+	 * The folder view and shell folder are looked up once and reused by every call until the shell
+	 * window they belong to goes away (Explorer restarting), which is checked without any COM calls.
+	 * @note COM must stay initialized for as long as the session holds anything.
+	 */
+	class ShellSession
+	{
+	public:
+
+		ShellSession() = default;
+
+		ShellSession(const ShellSession&) = delete;
+		ShellSession& operator=(const ShellSession&) = delete;
+
+		/**
+		 * Get the folder view of the desktop.
+		 * @return Desktop folder view.
+		 */
+		CComPtr<IFolderView2> get_view();
+
+		/**
+		 * Get the shell folder of the desktop.
+		 * @return Desktop shell folder.
+		 */
+		CComPtr<IShellFolder> get_folder();
+
+		/**
+		 * Get the list view window drawing the desktop icons.
+		 * @return List view window, or NULL if there is none.
+		 */
+		HWND get_list_view();
+
+		/**
+		 * Let go of the shell objects.
+		 */
+		void reset();
+
+		/**
+		 * Get the number of times the shell objects were looked up.
+		 * @return Number of lookups.
+		 */
+		inline size_t get_acquire_count() const noexcept;
+
+	private:
+
+		/**
+		 * Look up the shell objects again if the shell window is gone.
+		 */
+		void revalidate();
+
+		/** Desktop folder view. */
+		CComPtr<IFolderView2> m_view = nullptr;
+
+		/** Desktop shell folder. */
+		CComPtr<IShellFolder> m_folder = nullptr;
+
+		/** Window of the shell view, used to notice when the shell goes away. */
+		HWND m_window = NULL;
+
+		/** Number of times the shell objects were looked up. */
+		size_t m_acquisitions = 0;
+	};
+}
+
+#include "win32_shell_session.imp.hpp"
@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * @file win32_shell_session.imp.hpp
+ * @brief Windows shell session header implementation file.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+namespace ds
+{
+	inline size_t ShellSession::get_acquire_count() const noexcept
+	{
+		return m_acquisitions;
+	}
+}